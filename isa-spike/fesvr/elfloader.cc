@@ -18,6 +18,46 @@
 #include <map>
 #include <cerrno>
 
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
+
+// Load a segment of filesz bytes at offset in the file, zero-padded to memsz
+// bytes, into host memory at dst.  The pages it covers whole are mapped
+// copy-on-write from the file, where the file offset and dst line up, or
+// swapped for fresh pages the OS zeroes on first touch.  Only the ragged
+// edges are copied or cleared here.
+static void map_segment(int fd, const char* buf, size_t offset, size_t filesz,
+                        size_t memsz, char* dst)
+{
+  const uintptr_t pgsize = sysconf(_SC_PAGESIZE);
+  auto page_up = [pgsize](uintptr_t x) { return (x + pgsize - 1) & ~(pgsize - 1); };
+  auto page_down = [pgsize](uintptr_t x) { return x & ~(pgsize - 1); };
+
+  char* begin = (char*)page_up((uintptr_t)dst);
+  char* end = (char*)page_down((uintptr_t)dst + filesz);
+  if ((uintptr_t)(dst - offset) % pgsize == 0 && begin < end &&
+      mmap(begin, end - begin, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+           fd, offset + (begin - dst)) != MAP_FAILED) {
+    memcpy(dst, buf + offset, begin - dst);
+    memcpy(end, buf + offset + (end - dst), dst + filesz - end);
+  } else {
+    memcpy(dst, buf + offset, filesz);
+  }
+
+  char* pad = dst + filesz;
+  begin = (char*)page_up((uintptr_t)pad);
+  end = (char*)page_down((uintptr_t)dst + memsz);
+  if (begin < end &&
+      mmap(begin, end - begin, PROT_READ | PROT_WRITE,
+           MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_NORESERVE, -1, 0) != MAP_FAILED) {
+    memset(pad, 0, begin - pad);
+    memset(end, 0, dst + memsz - end);
+  } else {
+    memset(pad, 0, memsz - filesz);
+  }
+}
+
 std::map<std::string, uint64_t> load_elf(const char* fn, memif_t* memif, reg_t* entry,
                                          reg_t load_offset, unsigned required_xlen = 0)
 {
@@ -32,13 +72,13 @@ std::map<std::string, uint64_t> load_elf(const char* fn, memif_t* memif, reg_t*
   char* buf = (char*)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
   if (buf == MAP_FAILED)
       throw std::invalid_argument(std::string("Specified ELF can't be mapped: ") + strerror(errno));
-  close(fd);
 
   assert(size >= sizeof(Elf64_Ehdr));
   const Elf64_Ehdr* eh64 = (const Elf64_Ehdr*)buf;
   assert(IS_ELF32(*eh64) || IS_ELF64(*eh64));
   unsigned xlen = IS_ELF32(*eh64) ? 32 : 64;
   if (required_xlen != 0 && required_xlen != xlen) {
+    close(fd);
     throw incompat_xlen(required_xlen, xlen);
   }
   assert(IS_ELFLE(*eh64) || IS_ELFBE(*eh64));
@@ -62,6 +102,12 @@ std::map<std::string, uint64_t> load_elf(const char* fn, memif_t* memif, reg_t*
     for (unsigned i = 0; i < bswap(eh->e_phnum); i++) {                        \
       if (bswap(ph[i].p_type) == PT_LOAD && bswap(ph[i].p_memsz)) {            \
         reg_t load_addr = bswap(ph[i].p_paddr) + load_offset;                  \
+        if (char* host = memif->host_mem(load_addr, bswap(ph[i].p_memsz))) {   \
+          assert(size >= bswap(ph[i].p_offset) + bswap(ph[i].p_filesz));       \
+          map_segment(fd, buf, bswap(ph[i].p_offset), bswap(ph[i].p_filesz),   \
+                      bswap(ph[i].p_memsz), host);                             \
+          continue;                                                            \
+        }                                                                      \
         if (bswap(ph[i].p_filesz)) {                                           \
           assert(size >= bswap(ph[i].p_offset) + bswap(ph[i].p_filesz));       \
           memif->write(load_addr, bswap(ph[i].p_filesz),                       \
@@ -129,6 +175,7 @@ std::map<std::string, uint64_t> load_elf(const char* fn, memif_t* memif, reg_t*
   }
 
   munmap(buf, size);
+  close(fd);
 
   return symbols;
 }
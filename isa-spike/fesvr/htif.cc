@@ -142,6 +142,11 @@ std::map<std::string, uint64_t> htif_t::load_payload(const std::string& payload,
         memif_t::write(taddr, len, src);
     }
 
+    char* host_mem(addr_t taddr, size_t len) override
+    {
+      return htif->is_address_preloaded(taddr, len) ? NULL : memif_t::host_mem(taddr, len);
+    }
+
    private:
     htif_t* htif;
   } preload_aware_memif(this);
@@ -161,6 +166,7 @@ void htif_t::load_symbols(std::map<std::string, uint64_t>& symbols)
     nop_memif_t(htif_t* htif) : memif_t(htif) {}
     void read(addr_t UNUSED addr, size_t UNUSED len, void UNUSED *bytes) override {}
     void write(addr_t UNUSED taddr, size_t UNUSED len, const void UNUSED *src) override {}
+    char* host_mem(addr_t UNUSED taddr, size_t UNUSED len) override { return NULL; }
   } nop_memif(this);
 
   reg_t nop_entry;
@@ -23,6 +23,9 @@ public:
   virtual size_t chunk_align() = 0;
   virtual size_t chunk_max_size() = 0;
 
+  // host memory that backs [taddr, taddr + len) directly, if there is any
+  virtual char* host_mem(addr_t, size_t) { return NULL; }
+
   virtual endianness_t get_target_endianness() const {
     return endianness_little;
   }
@@ -64,6 +67,11 @@ public:
   virtual void write_uint64(addr_t addr, target_endian<uint64_t> val);
   virtual void write_int64(addr_t addr, target_endian<int64_t> val);
 
+  // host memory backing a range of bytes directly, or NULL
+  virtual char* host_mem(addr_t addr, size_t len) {
+    return cmemif->host_mem(addr, len);
+  }
+
   // endianness
   virtual endianness_t get_target_endianness() const {
     return cmemif->get_target_endianness();
@@ -0,0 +1,159 @@
+#include <stdint.h>
+
+// =========================================================
+// WORKLOAD PARAMETERS (set by run_suite.sh)
+// =========================================================
+#ifndef N_TASKS
+#define N_TASKS 4         // tasks in the round-robin set
+#endif
+#ifndef WINDOW_SIZE
+#define WINDOW_SIZE 32    // registers per task window
+#endif
+#ifndef SWITCH_EVERY
+#define SWITCH_EVERY 1    // kernel iterations between yields
+#endif
+#ifndef SWITCHES
+#define SWITCHES 200      // context switches before the run ends
+#endif
+#if !defined(KERNEL_IDLE) && !defined(KERNEL_MATMUL) && !defined(KERNEL_VMATMUL)
+#define KERNEL_IDLE
+#endif
+#ifndef VLEN
+#define VLEN 512          // vector register width, for the SW_SAVE area
+#endif
+
+#define STACK_WORDS 256
+
+// --- Hardware Definitions ---
+volatile char* const UART0 = (char*)0x10000000;
+void print_str(const char* s) { while (*s) *UART0 = *s++; }
+void print_hex(unsigned long val) {
+    char hex[] = "0123456789ABCDEF";
+    print_str("0x");
+    for (int i = 7; i >= 0; i--) *UART0 = hex[(val >> (i * 4)) & 0xF];
+}
+
+// --- TCB & Global State ---
+// The layout is shared with startup.S.
+typedef struct {
+    uint32_t regs[32];   // software-save area (SW_SAVE only)
+    uint32_t pc;
+    uint32_t window_cfg; // [Size (16) | Base (16)]
+    uint32_t sp;         // initial stack pointer
+    uint32_t id;
+    uint32_t vregs;      // vector save area (SW_SAVE with KERNEL_VMATMUL)
+} tcb_t;
+
+tcb_t tcbs[N_TASKS];
+tcb_t *current_task;
+uint32_t stacks[N_TASKS][STACK_WORDS];
+volatile uint32_t checksums[N_TASKS];
+#ifdef KERNEL_VMATMUL
+uint8_t vstate[N_TASKS][32 * VLEN / 8] __attribute__((aligned(16)));
+#endif
+unsigned long switches;
+
+extern void task_bootstrap(void);
+extern void exit_sim(void);
+
+// =========================================================
+// SCHEDULER
+// =========================================================
+static void finish(void) {
+    // Each task publishes its running checksum before it yields, so both
+    // variants must print the same values.
+    print_str("[BENCH] switches ");
+    print_hex(switches);
+    print_str("\n");
+    for (int i = 0; i < N_TASKS; i++) {
+        print_str("[BENCH] checksum ");
+        print_hex(checksums[i]);
+        print_str("\n");
+    }
+    exit_sim();
+}
+
+unsigned long run_scheduler(unsigned long old_pc) {
+    current_task->pc = old_pc;
+    if (++switches > SWITCHES)
+        finish();
+
+    tcb_t *next_task = &tcbs[(current_task->id + 1) % N_TASKS];
+#ifndef SW_SAVE
+    asm volatile("csrw 0x801, %0" :: "r"(next_task->window_cfg));
+#endif
+    current_task = next_task;
+    asm volatile("csrw mscratch, %0" :: "r"(current_task));
+
+    return next_task->pc;
+}
+
+// =========================================================
+// TASKS
+// =========================================================
+#ifdef KERNEL_MATMUL
+static uint32_t kernel_step(uint32_t acc) {
+    uint32_t a[4][4], b[4][4], c = 0;
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++) {
+            a[i][j] = acc + i;
+            b[i][j] = acc ^ j;
+        }
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++)
+            for (int k = 0; k < 4; k++)
+                c += a[i][k] * b[k][j];
+    return acc + c;
+}
+#elif defined(KERNEL_VMATMUL)
+extern void vmatmul_init(void);
+extern uint32_t vmatmul_step(uint32_t acc);
+static uint32_t kernel_step(uint32_t acc) {
+    return vmatmul_step(acc);
+}
+#else
+static uint32_t kernel_step(uint32_t acc) {
+    return acc * 33 + 1;
+}
+#endif
+
+void task_main(uint32_t id) {
+    // acc lives in a register across every yield, so a lost or corrupted
+    // window shows up as a checksum mismatch.
+    uint32_t acc = id + 1;
+#ifdef KERNEL_VMATMUL
+    vmatmul_init();
+#endif
+    for (;;) {
+        for (int i = 0; i < SWITCH_EVERY; i++)
+            acc = kernel_step(acc);
+        checksums[id] = acc;
+        asm volatile("ecall" ::: "memory");
+    }
+}
+
+int main() {
+    for (int i = 0; i < N_TASKS; i++) {
+        tcbs[i].id = i;
+        tcbs[i].pc = (uint32_t)task_bootstrap;
+        tcbs[i].sp = (uint32_t)&stacks[i][STACK_WORDS];
+        // Task windows sit above the kernel window (0, 32).
+        tcbs[i].window_cfg = (WINDOW_SIZE << 16) | (32 + i * WINDOW_SIZE);
+#ifdef KERNEL_VMATMUL
+        tcbs[i].vregs = (uint32_t)vstate[i];
+#endif
+    }
+
+    // Start task 0 with an mret that stays in M-mode.
+    current_task = &tcbs[0];
+#ifndef SW_SAVE
+    asm volatile("csrw 0x801, %0" :: "r"(current_task->window_cfg));
+#endif
+    asm volatile("csrw mscratch, %0" :: "r"(current_task));
+    asm volatile("csrw mepc, %0" :: "r"(current_task->pc));
+#ifdef KERNEL_VMATMUL
+    asm volatile("li t0, 0x200; csrs mstatus, t0" ::: "t0"); // mstatus.VS = Initial
+#endif
+    asm volatile("li t0, 0x1800; csrs mstatus, t0; mret" ::: "t0");
+    return 0;
+}
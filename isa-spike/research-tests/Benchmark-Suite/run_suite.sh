@@ -0,0 +1,140 @@
+#!/bin/sh
+# Register-window benchmark suite.
+#
+# Builds one task-set workload per combination of the parameters below and
+# runs it three ways: with hardware register windows (HRW), the same binary
+# with --rf-partitioning=off (OFF, window switches done by emulated firmware
+# save/restore), and a build whose trap handler saves and restores registers
+# itself (SW).  Prints a Markdown table comparing the trap-to-next-task
+# latency that spike's --switch-profile measures; the speedup is OFF over
+# HRW in average cycles.
+#
+# The vmatmul kernel keeps an accumulator in the vector registers across
+# yields.  Its HRW run gives each task window a vector bank of its own
+# (--vector-banks), and its SW build also saves and restores all 32 vector
+# registers, VLEN/8 bytes each.  The OFF firmware saves no vector state, so
+# vmatmul has no OFF run and its speedup is SW over HRW.
+#
+# Parameters (environment, space-separated lists):
+#   TASKS     number of tasks                        [2 4 8]
+#   WINDOWS   registers per task window (16..32)     [16 32]
+#   PERIODS   kernel iterations between yields       [1 16]
+#   KERNELS   compute kernel, idle, matmul or vmatmul [idle matmul vmatmul]
+#   SWITCHES  context switches per run               [200]
+#   VLEN      vector register width for vmatmul      [512]
+#   SPIKE     simulator                              [../../build/spike]
+#   CROSS     toolchain prefix                       [riscv32-unknown-elf-]
+#   CYCLE_MODEL  --cycle-model configuration         [load:2]
+#   SAVE_AREA    window save area for the OFF runs   [0x90000000]
+
+set -e
+cd "$(dirname "$0")"
+
+: "${TASKS:=2 4 8}"
+: "${WINDOWS:=16 32}"
+: "${PERIODS:=1 16}"
+: "${KERNELS:=idle matmul vmatmul}"
+: "${SWITCHES:=200}"
+: "${VLEN:=512}"
+: "${SPIKE:=../../build/spike}"
+: "${CROSS:=riscv32-unknown-elf-}"
+: "${CYCLE_MODEL:=load:2}"
+: "${SAVE_AREA:=0x90000000}"
+
+CC="${CROSS}gcc"
+CFLAGS="-march=rv32ima_zicsr -mabi=ilp32 -O2 -nostdlib -nostartfiles -ffreestanding -T link.ld"
+OUT=build
+
+# Registers x<size> .. x31 lie outside a task window, so keep the compiler
+# from allocating them.
+fixed_regs() {
+  names="x0 ra sp gp tp t0 t1 t2 s0 s1 a0 a1 a2 a3 a4 a5 a6 a7 s2 s3 s4 s5 s6 s7 s8 s9 s10 s11 t3 t4 t5 t6"
+  i=0
+  for r in $names; do
+    [ $i -ge "$1" ] && printf -- "-ffixed-%s " "$r"
+    i=$((i + 1))
+  done
+}
+
+# Print the min/avg/p99/max/jitter fields of one switch profile metric.
+profile() {
+  awk -v metric="$2" '
+    /^Switch Profile exception/ { found = 1; next }
+    /^Switch Profile/ { found = 0 }
+    found && $1 == metric { print $3, $5, $7, $9, $11 }' "$1"
+}
+
+checksums() {
+  grep '^\[BENCH\] checksum' "$1" | tr '\n' ' '
+}
+
+mkdir -p $OUT
+
+echo "| tasks | window | period | kernel | HRW instr avg/p99 | OFF instr avg/p99 | SW instr avg/p99 | HRW cycles avg/p99/jitter | OFF cycles avg/p99/jitter | SW cycles avg/p99/jitter | speedup | checksums |"
+echo "|------:|-------:|-------:|--------|------------------:|------------------:|-----------------:|--------------------------:|--------------------------:|-------------------------:|--------:|-----------|"
+
+for t in $TASKS; do
+  for w in $WINDOWS; do
+    if [ "$w" -lt 16 ] || [ "$w" -gt 32 ]; then
+      echo "window size $w is outside 16..32" >&2
+      exit 1
+    fi
+    for p in $PERIODS; do
+      for k in $KERNELS; do
+        name=t$t-w$w-p$p-$k
+        flags="-DN_TASKS=$t -DWINDOW_SIZE=$w -DSWITCH_EVERY=$p -DSWITCHES=$SWITCHES -DKERNEL_$(echo $k | tr a-z A-Z) $(fixed_regs $w)"
+        isa=rv32ima
+        srcs="startup.S main.c"
+        if [ "$k" = vmatmul ]; then
+          # Task i's window (32 + i*w, w) selects vector bank 32/w + i.
+          isa=rv32imav_zvl${VLEN}b
+          srcs="startup.S vkernel.S main.c"
+          flags="$flags -DVLEN=$VLEN"
+        fi
+        $CC $CFLAGS $flags -o $OUT/$name-hrw.elf $srcs
+        $CC $CFLAGS $flags -DSW_SAVE -o $OUT/$name-sw.elf $srcs
+
+        $SPIKE --isa=$isa --phys-regs=$((32 + t * w)) --vector-banks=$((32 / w + t)) --cycle-model=$CYCLE_MODEL \
+          --switch-profile=$OUT/$name-hrw.csv $OUT/$name-hrw.elf > $OUT/$name-hrw.log
+        if [ "$k" != vmatmul ]; then
+          $SPIKE --isa=$isa --cycle-model=$CYCLE_MODEL --rf-partitioning=off --window-spill=$SAVE_AREA \
+            --switch-profile=$OUT/$name-off.csv $OUT/$name-hrw.elf > $OUT/$name-off.log
+        fi
+        $SPIKE --isa=$isa --cycle-model=$CYCLE_MODEL \
+          --switch-profile=$OUT/$name-sw.csv $OUT/$name-sw.elf > $OUT/$name-sw.log
+
+        set -- $(profile $OUT/$name-hrw.log instructions)
+        hrw_instr="$2/$3"
+        set -- $(profile $OUT/$name-hrw.log cycles)
+        hrw_cycles="$2/$3/$5"
+        hrw_avg=$2
+        set -- $(profile $OUT/$name-sw.log instructions)
+        sw_instr="$2/$3"
+        set -- $(profile $OUT/$name-sw.log cycles)
+        sw_cycles="$2/$3/$5"
+        base_avg=$2
+        off_log=$OUT/$name-sw.log
+        off_instr=n/a
+        off_cycles=n/a
+        if [ "$k" != vmatmul ]; then
+          off_log=$OUT/$name-off.log
+          set -- $(profile $off_log instructions)
+          off_instr="$2/$3"
+          set -- $(profile $off_log cycles)
+          off_cycles="$2/$3/$5"
+          base_avg=$2
+        fi
+
+        speedup=$(awk -v a="$base_avg" -v b="$hrw_avg" 'BEGIN { printf "%.2fx", b > 0 ? a / b : 0 }')
+        sums=$(checksums $OUT/$name-hrw.log)
+        if [ "$sums" = "$(checksums $off_log)" ] && [ "$sums" = "$(checksums $OUT/$name-sw.log)" ]; then
+          match=ok
+        else
+          match=MISMATCH
+        fi
+
+        echo "| $t | $w | $p | $k | $hrw_instr | $off_instr | $sw_instr | $hrw_cycles | $off_cycles | $sw_cycles | $speedup | $match |"
+      done
+    done
+  done
+done
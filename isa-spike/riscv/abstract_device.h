@@ -19,6 +19,11 @@ class abstract_device_t {
   virtual reg_t size() = 0;
   virtual ~abstract_device_t() {}
   virtual void tick(reg_t UNUSED rtc_ticks) {}
+  // RTC ticks from now until the device next changes state on its own, e.g.
+  // a timer compare crossing, so that the harts can be stopped exactly
+  // there; NO_EVENT if it has nothing scheduled.
+  static const reg_t NO_EVENT = reg_t(-1);
+  virtual reg_t next_event() { return NO_EVENT; }
 };
 
 // factory for devices which should show up in the DTS, and can be
@@ -42,9 +42,29 @@ cfg_t::cfg_t()
   pmpregions       = 16;
   pmpgranularity   = (1 << PMP_SHIFT);
   mem_layout       = std::vector<mem_cfg_t>({mem_cfg_t(reg_t(DRAM_BASE), (size_t)2048 << 20)});
+  mem_backing      = mem_backing_sparse;
   hartids          = std::vector<size_t>({0});
   explicit_hartids = false;
   real_time_clint  = false;
   trigger_count    = 4;
   cache_blocksz    = 64;
+  cycle_model      = nullptr;
+  phys_regs        = NXPR_PHYS_DEFAULT;
+  phys_fregs       = NFPR_PHYS_DEFAULT;
+  vector_banks     = 1;
+  window_granularity = 1;
+  dump_regfile_on  = 0;
+  trap_windows     = nullptr;
+  lazy_fpv         = nullptr;
+  switch_profile   = nullptr;
+  clic_ndev        = 0;
+  rf_partitioning  = true;
+  quantum          = 0;
+  parallel_harts   = false;
+  commit_trace     = nullptr;
+  icache_entries   = 4096;
+  icache_ways      = 1;
+  tlb_entries      = 256;
+  tlb_ways         = 1;
+  sim_cache_stats  = false;
 }
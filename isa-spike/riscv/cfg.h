@@ -13,6 +13,14 @@ typedef enum {
   endianness_big
 } endianness_t;
 
+// How a mem_t holds guest RAM: page by page as it is touched, or as one
+// mapping of the whole region, optionally on huge pages
+typedef enum {
+  mem_backing_sparse,
+  mem_backing_flat,
+  mem_backing_huge
+} mem_backing_t;
+
 template <typename T>
 class cfg_arg_t {
 public:
@@ -72,12 +80,33 @@ public:
   reg_t                   pmpregions;
   reg_t                   pmpgranularity;
   std::vector<mem_cfg_t>  mem_layout;
+  mem_backing_t           mem_backing;
   std::optional<reg_t>    start_pc;
   std::vector<size_t>     hartids;
   bool                    explicit_hartids;
   bool                    real_time_clint;
   reg_t                   trigger_count;
   reg_t                   cache_blocksz;
+  const char *            cycle_model;
+  reg_t                   phys_regs;
+  reg_t                   phys_fregs;
+  reg_t                   vector_banks;
+  reg_t                   window_granularity;
+  std::optional<reg_t>    window_save_area;
+  reg_t                   dump_regfile_on;
+  const char *            trap_windows;
+  const char *            lazy_fpv;
+  const char *            switch_profile;
+  uint32_t                clic_ndev;
+  bool                    rf_partitioning;
+  reg_t                   quantum;
+  bool                    parallel_harts;
+  const char *            commit_trace;
+  reg_t                   icache_entries;
+  reg_t                   icache_ways;
+  reg_t                   tlb_entries;
+  reg_t                   tlb_ways;
+  bool                    sim_cache_stats;
   std::optional<abstract_sim_if_t*> external_simulator;
 
   size_t nprocs() const { return hartids.size(); }
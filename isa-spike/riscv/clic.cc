@@ -0,0 +1,212 @@
+#include <sstream>
+#include "devices.h"
+#include "processor.h"
+#include "simif.h"
+#include "sim.h"
+#include "dts.h"
+
+/*
+ * A CLIC-style core-local interrupt controller.  Each interrupt source has
+ * a level and priority, a handler vector and a register window, so taking
+ * it jumps straight into the source's own handler and partition with no
+ * dispatch code in a shared mtvec handler.  A source preempts the running
+ * handler only if its level is higher; the interrupted level is saved in
+ * mcause.mpil and restored by mret.
+ *
+ * Each hart has its own block, at base + hart index * CLIC_HART_SIZE:
+ *
+ * 0x0000: cliccfg, nlbits in bits 4:1
+ * 0x0004: clicinfo, number of interrupt IDs (read-only)
+ * 0x0008: mintthresh, interrupts at or below this level are masked
+ * 0x000C: mintstatus, level of the running handler (read-only)
+ * 0x1000: clicintip, clicintie, clicintattr, clicintctl for source 0
+ * 0x1004: ... for source 1
+ * ...
+ * 0x4000: 64-bit handler vector for source 0
+ * 0x4008: ... for source 1
+ * ...
+ * 0x8000: window config [Size(16) | Base(16)] for source 0
+ * 0x8004: ... for source 1
+ *
+ * Sources below CLIC_FIRST_SOURCE overlap the standard mip causes, which
+ * stay with the CLINT and mip, so their registers read as zero.
+ */
+
+#define CLIC_CFG          0x0
+#define CLIC_INFO         0x4
+#define CLIC_THRESH       0x8
+#define CLIC_STATUS       0xc
+#define CLIC_INT_BASE     0x1000
+#define CLIC_INT_PER_ID   4
+#define CLIC_VEC_BASE     0x4000
+#define CLIC_VEC_PER_ID   8
+#define CLIC_WIN_BASE     0x8000
+#define CLIC_WIN_PER_ID   4
+
+// The level is the top nlbits of clicintctl, with the bits below set.
+uint8_t clic_context_t::level_of(uint8_t ctl) const
+{
+  return ctl | (0xff >> nlbits);
+}
+
+// Sources rank by clicintctl, ties going to the higher ID.
+void clic_context_t::update()
+{
+  uint32_t best = 0;
+  for (uint32_t id = CLIC_FIRST_SOURCE; id < sources.size(); id++) {
+    const clic_source_t& s = sources[id];
+    if (s.ip && s.ie && (!best || s.ctl >= sources[best].ctl))
+      best = id;
+  }
+  best_id = best;
+}
+
+uint8_t clic_context_t::claim(uint32_t id)
+{
+  uint8_t prev = level;
+  level = level_of(sources[id].ctl);
+  if (sources[id].attr & CLIC_ATTR_EDGE)
+    sources[id].ip = 0;
+  update();
+  return prev;
+}
+
+clic_t::clic_t(const simif_t* sim, uint32_t ndev)
+  : num_ids(std::min(ndev + 1, (uint32_t)CLIC_MAX_SOURCES))
+{
+  // Blocks are contiguous in memory even if harts are discontiguous.
+  contexts.reserve(sim->get_harts().size());
+  for (const auto& [hart_id, hart] : sim->get_harts()) {
+    contexts.push_back(clic_context_t(hart, num_ids));
+  }
+  for (auto& c : contexts)
+    c.proc->set_clic(&c);
+}
+
+bool clic_t::reg_read(clic_context_t* c, reg_t offset, uint8_t* val)
+{
+  *val = 0;
+  if (offset < CLIC_INT_BASE) {
+    uint32_t word = 0;
+    switch (offset & ~reg_t(3)) {
+      case CLIC_CFG: word = c->nlbits << 1; break;
+      case CLIC_INFO: word = num_ids; break;
+      case CLIC_THRESH: word = c->threshold; break;
+      case CLIC_STATUS: word = c->level; break;
+    }
+    read_little_endian_reg(word, offset, 1, val);
+    return true;
+  }
+
+  uint32_t id;
+  if (offset < CLIC_VEC_BASE) {
+    id = (offset - CLIC_INT_BASE) / CLIC_INT_PER_ID;
+    if (id >= CLIC_FIRST_SOURCE && id < num_ids) {
+      const clic_source_t& s = c->sources[id];
+      const uint8_t regs[CLIC_INT_PER_ID] = { s.ip, s.ie, s.attr, s.ctl };
+      *val = regs[offset % CLIC_INT_PER_ID];
+    }
+  } else if (offset < CLIC_WIN_BASE) {
+    id = (offset - CLIC_VEC_BASE) / CLIC_VEC_PER_ID;
+    if (id >= CLIC_FIRST_SOURCE && id < num_ids)
+      read_little_endian_reg(c->sources[id].vector, offset, 1, val);
+  } else {
+    id = (offset - CLIC_WIN_BASE) / CLIC_WIN_PER_ID;
+    if (id >= CLIC_FIRST_SOURCE && id < num_ids)
+      read_little_endian_reg(c->sources[id].window, offset, 1, val);
+  }
+  return true;
+}
+
+bool clic_t::reg_write(clic_context_t* c, reg_t offset, uint8_t val)
+{
+  if (offset < CLIC_INT_BASE) {
+    if (offset == CLIC_CFG)
+      c->nlbits = std::min((val >> 1) & 0xf, 8);
+    else if (offset == CLIC_THRESH)
+      c->threshold = val;
+    return true;
+  }
+
+  uint32_t id;
+  if (offset < CLIC_VEC_BASE) {
+    id = (offset - CLIC_INT_BASE) / CLIC_INT_PER_ID;
+    if (id >= CLIC_FIRST_SOURCE && id < num_ids) {
+      clic_source_t& s = c->sources[id];
+      switch (offset % CLIC_INT_PER_ID) {
+        case 0: s.ip = val & 1; break;
+        case 1: s.ie = val & 1; break;
+        case 2: s.attr = val & (CLIC_ATTR_SHV | CLIC_ATTR_EDGE); break;
+        case 3: s.ctl = val; break;
+      }
+    }
+  } else if (offset < CLIC_WIN_BASE) {
+    id = (offset - CLIC_VEC_BASE) / CLIC_VEC_PER_ID;
+    if (id >= CLIC_FIRST_SOURCE && id < num_ids)
+      write_little_endian_reg(&c->sources[id].vector, offset, 1, &val);
+  } else {
+    id = (offset - CLIC_WIN_BASE) / CLIC_WIN_PER_ID;
+    if (id >= CLIC_FIRST_SOURCE && id < num_ids)
+      write_little_endian_reg(&c->sources[id].window, offset, 1, &val);
+  }
+  return true;
+}
+
+bool clic_t::load(reg_t addr, size_t len, uint8_t* bytes)
+{
+  if (len > 8 || addr + len > size() || addr % CLIC_HART_SIZE + len > CLIC_HART_SIZE)
+    return false;
+
+  clic_context_t* c = &contexts[addr / CLIC_HART_SIZE];
+  for (size_t i = 0; i < len; i++) {
+    if (!reg_read(c, (addr + i) % CLIC_HART_SIZE, &bytes[i]))
+      return false;
+  }
+  return true;
+}
+
+bool clic_t::store(reg_t addr, size_t len, const uint8_t* bytes)
+{
+  if (len > 8 || addr + len > size() || addr % CLIC_HART_SIZE + len > CLIC_HART_SIZE)
+    return false;
+
+  clic_context_t* c = &contexts[addr / CLIC_HART_SIZE];
+  for (size_t i = 0; i < len; i++) {
+    if (!reg_write(c, (addr + i) % CLIC_HART_SIZE, bytes[i]))
+      return false;
+  }
+  c->update();
+  return true;
+}
+
+std::string clic_generate_dts(const sim_t* sim, const std::vector<std::string>& sargs UNUSED)
+{
+  uint32_t ndev = sim->get_cfg().clic_ndev;
+  if (!ndev)
+    return "";
+
+  std::stringstream s;
+  s << std::hex
+    << "    clic@" << CLIC_BASE << " {\n"
+       "      compatible = \"riscv,clic0\";\n";
+  reg_t clicbs = CLIC_BASE;
+  reg_t clicsz = CLIC_HART_SIZE * sim->get_cfg().nprocs();
+  s << "      reg = <0x" << (clicbs >> 32) << " 0x" << (clicbs & (uint32_t)-1) <<
+      " 0x" << (clicsz >> 32) << " 0x" << (clicsz & (uint32_t)-1) << ">;\n"
+      "      riscv,ndev = <0x" << ndev << ">;\n"
+      "      interrupt-controller;\n"
+      "    };\n";
+  return s.str();
+}
+
+clic_t* clic_parse_from_fdt(const void* fdt, const sim_t* sim, reg_t* base, const std::vector<std::string>& sargs UNUSED)
+{
+  uint32_t clic_ndev;
+  // The CLIC node has the same reg and riscv,ndev properties as the PLIC's.
+  if (fdt_parse_plic(fdt, base, &clic_ndev, "riscv,clic0") == 0)
+    return new clic_t(sim, clic_ndev);
+  else
+    return nullptr;
+}
+
+REGISTER_BUILTIN_DEVICE(clic, clic_parse_from_fdt, clic_generate_dts)
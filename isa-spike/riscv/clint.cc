@@ -118,6 +118,21 @@ void clint_t::tick(reg_t rtc_ticks)
   }
 }
 
+reg_t clint_t::next_event()
+{
+  // In real-time mode mtime follows the wall clock, not the harts.
+  if (real_time)
+    return NO_EVENT;
+
+  reg_t next = NO_EVENT;
+  for (const auto& [hart_id, hart] : sim->get_harts()) {
+    auto it = mtimecmp.find(hart_id);
+    if (it != mtimecmp.end() && it->second > mtime)
+      next = std::min(next, reg_t(it->second - mtime));
+  }
+  return next;
+}
+
 clint_t* clint_parse_from_fdt(const void* fdt, const sim_t* sim, reg_t* base,
     const std::vector<std::string>& sargs UNUSED) {
   if (fdt_parse_clint(fdt, base, "riscv,clint0") == 0 || fdt_parse_clint(fdt, base, "sifive,clint0") == 0)
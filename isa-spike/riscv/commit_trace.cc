@@ -0,0 +1,86 @@
+// See LICENSE for license details.
+
+#include "commit_trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+const size_t commit_ring_t::SIZE;
+
+// The ring is full of records the writer hasn't seen yet, possibly part of
+// an unpublished group, so publish what there is and wait for it to drain.
+void commit_ring_t::wait_for_space()
+{
+  publish();
+  while (fill - tail.load(std::memory_order_acquire) == SIZE)
+    std::this_thread::yield();
+}
+
+size_t commit_ring_t::drain(FILE* out)
+{
+  size_t t = tail.load(std::memory_order_relaxed);
+  size_t h = head.load(std::memory_order_acquire);
+  size_t n = h - t;
+
+  while (t != h) {
+    size_t chunk = std::min(h - t, SIZE - t % SIZE);
+    fwrite(&records[t % SIZE], sizeof(commit_record_t), chunk, out);
+    t += chunk;
+  }
+
+  tail.store(t, std::memory_order_release);
+  return n;
+}
+
+commit_trace_t::commit_trace_t(const std::string& path, size_t nprocs)
+  : stopping(false)
+{
+  for (size_t i = 0; i < nprocs; i++) {
+    std::string name = path;
+    if (nprocs > 1) {
+      size_t dot = name.find_last_of('.');
+      size_t slash = name.find_last_of('/');
+      if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        dot = name.size();
+      name.insert(dot, "." + std::to_string(i));
+    }
+
+    FILE* f = fopen(name.c_str(), "wb");
+    if (!f) {
+      std::cerr << "Could not open commit trace " << name << ": " << strerror(errno) << std::endl;
+      exit(1);
+    }
+    fwrite(COMMIT_TRACE_MAGIC, 1, sizeof(COMMIT_TRACE_MAGIC), f);
+
+    files.push_back(f);
+    rings.push_back(new commit_ring_t);
+  }
+
+  writer = std::thread(&commit_trace_t::run_writer, this);
+}
+
+commit_trace_t::~commit_trace_t()
+{
+  stopping.store(true, std::memory_order_release);
+  writer.join();
+
+  for (size_t i = 0; i < rings.size(); i++) {
+    rings[i]->publish();
+    rings[i]->drain(files[i]);
+    fclose(files[i]);
+    delete rings[i];
+  }
+}
+
+void commit_trace_t::run_writer()
+{
+  while (!stopping.load(std::memory_order_acquire)) {
+    size_t n = 0;
+    for (size_t i = 0; i < rings.size(); i++)
+      n += rings[i]->drain(files[i]);
+    if (n == 0)
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+}
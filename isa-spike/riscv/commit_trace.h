@@ -0,0 +1,98 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_COMMIT_TRACE_H
+#define _RISCV_COMMIT_TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Binary commit trace.
+//
+// With --commit-trace, each committed instruction is written as a group of
+// fixed-size records instead of a --log-commits text line: a COMMIT_INSN
+// record, followed by one record per register write, memory read and memory
+// write, in the order --log-commits prints them.  Each hart fills its own
+// ring, and one writer thread drains the rings to the trace files, so
+// nothing is formatted on the simulation threads and they only wait for I/O
+// when a ring is full.  spike-commit-decode turns a trace file back into
+// --log-commits text.
+//
+// A trace file is COMMIT_TRACE_MAGIC followed by records.
+
+#define COMMIT_TRACE_MAGIC "SPKCMT1"
+
+enum commit_record_kind_t : uint8_t {
+  COMMIT_INSN,  // a = priv, b = xlen | flen << 8, c = hart ID, x = pc, y = bits
+  COMMIT_REG,   // a = type (0 x, 1 f, 4 CSR), b = register, x/y = value
+  COMMIT_VTYPE, // b = SEW, c = LMUL, negated if fractional, x = vl
+  COMMIT_VREG,  // b = register, c = VLEN; the value follows in COMMIT_DATA
+  COMMIT_DATA,  // x/y = next 16 bytes of the preceding record's value
+  COMMIT_LOAD,  // x = address
+  COMMIT_STORE, // a = size in bytes, x = address, y = value
+};
+
+struct commit_record_t
+{
+  uint8_t kind;
+  uint8_t a;
+  uint16_t b;
+  uint32_t c;
+  uint64_t x;
+  uint64_t y;
+};
+
+// Single-producer, single-consumer ring of records.  The hart pushes a
+// group of records and then publishes it; the writer only sees published
+// records.
+class commit_ring_t
+{
+public:
+  static const size_t SIZE = 1 << 16; // records, a power of two
+
+  commit_ring_t() : records(SIZE), fill(0), head(0), tail(0) {}
+
+  void push(const commit_record_t& r)
+  {
+    if (fill - tail.load(std::memory_order_acquire) == SIZE)
+      wait_for_space();
+    records[fill % SIZE] = r;
+    fill++;
+  }
+
+  void publish() { head.store(fill, std::memory_order_release); }
+
+  // Writes the published records to out; returns how many there were.
+  size_t drain(FILE* out);
+
+private:
+  void wait_for_space();
+
+  std::vector<commit_record_t> records;
+  size_t fill; // producer's next slot, published or not
+  std::atomic<size_t> head; // end of the published records
+  std::atomic<size_t> tail; // end of the records already written
+};
+
+class commit_trace_t
+{
+public:
+  // With several harts, hart n writes <name>.<n><ext>.
+  commit_trace_t(const std::string& path, size_t nprocs);
+  ~commit_trace_t();
+
+  commit_ring_t* ring(size_t i) { return rings[i]; }
+
+private:
+  void run_writer();
+
+  std::vector<commit_ring_t*> rings;
+  std::vector<FILE*> files;
+  std::atomic<bool> stopping;
+  std::thread writer;
+};
+
+#endif
@@ -110,7 +110,21 @@ void state_t::csr_init(processor_t* const proc, reg_t max_isa)
     const reg_t which_counter = CSR_HPMCOUNTER3 + i;
     const reg_t which_counterh = CSR_HPMCOUNTER3H + i;
     mevent[i] = std::make_shared<mevent_csr_t>(proc, which_mevent);
-    auto mcounter = std::make_shared<const_csr_t>(proc, which_mcounter, 0);
+    // With a cycle model attached, the first few counters report its cycle
+    // categories (see cycle_model_t::event_t); the rest remain hardwired to 0.
+    csr_t_p mcounter, mcounterh;
+    if (proc->get_cycle_model() && i < cycle_model_t::N_EVENTS) {
+      mhpmcounter[i] = std::make_shared<wide_counter_csr_t>(proc, which_mcounter, mcyclecfg);
+      if (xlen == 32) {
+        mcounter = std::make_shared<rv32_low_csr_t>(proc, which_mcounter, mhpmcounter[i]);
+        mcounterh = std::make_shared<rv32_high_csr_t>(proc, which_mcounterh, mhpmcounter[i]);
+      } else {
+        mcounter = mhpmcounter[i];
+      }
+    } else {
+      mcounter = std::make_shared<const_csr_t>(proc, which_mcounter, 0);
+      mcounterh = std::make_shared<const_csr_t>(proc, which_mcounterh, 0);
+    }
     add_csr(which_mcounter, mcounter);
 
     auto counter = std::make_shared<counter_proxy_csr_t>(proc, which_counter, mcounter);
@@ -118,7 +132,6 @@ void state_t::csr_init(processor_t* const proc, reg_t max_isa)
 
     if (xlen == 32) {
       add_csr(which_mevent, std::make_shared<rv32_low_csr_t>(proc, which_mevent, mevent[i]));
-      auto mcounterh = std::make_shared<const_csr_t>(proc, which_mcounterh, 0);
       add_csr(which_mcounterh, mcounterh);
       add_const_ext_csr(EXT_ZIHPM, which_counterh, std::make_shared<counter_proxy_csr_t>(proc, which_counterh, mcounterh));
       add_const_ext_csr(EXT_SSCOFPMF, which_meventh, std::make_shared<rv32_high_csr_t>(proc, which_meventh, mevent[i]));
@@ -0,0 +1,227 @@
+// See LICENSE for license details.
+
+#include "cycle_model.h"
+#include "encoding.h"
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+static void help()
+{
+  std::cerr << "Cycle model configurations must be of the form" << std::endl;
+  std::cerr << "  key:cycles[,key:cycles...]" << std::endl;
+  std::cerr << "where key is one of alu, mul, div, fp, load, store, branch, csr," << std::endl;
+  std::cerr << "xret, trap, window, or load-use.  A nonzero load-use enables the" << std::endl;
+  std::cerr << "in-order load-use interlock.  Instruction latencies must be at least 1." << std::endl;
+  exit(1);
+}
+
+static const char* event_names[cycle_model_t::N_EVENTS] = {
+  "Load-Use Stall Cycles:",
+  "Trap Entry Cycles:    ",
+  "xRET Cycles:          ",
+  "Window Switch Cycles: ",
+  "Memory Cycles:        ",
+  "Branch Cycles:        ",
+  "Window Spill Cycles:  ",
+};
+
+cycle_model_t::cycle_model_t(const char* config)
+  : alu(1), mul(3), div(20), fp(2), load(2), store(1), branch(2), csr(2),
+    xret(3), trap(5), window(1), load_use(0),
+    extra_cycles(0), event_cycles(), total_event_cycles(), total_extra_cycles(0),
+    retired(0), pending_load_rd(0)
+{
+  std::string s(config);
+  size_t pos = 0;
+  while (pos < s.size()) {
+    size_t end = s.find(',', pos);
+    if (end == std::string::npos)
+      end = s.size();
+    std::string item = s.substr(pos, end - pos);
+    pos = end + 1;
+
+    size_t colon = item.find(':');
+    if (colon == std::string::npos || colon + 1 == item.size())
+      help();
+    std::string key = item.substr(0, colon);
+    char* p;
+    reg_t val = strtoull(item.c_str() + colon + 1, &p, 0);
+    if (*p)
+      help();
+
+    if (key == "alu") alu = val;
+    else if (key == "mul") mul = val;
+    else if (key == "div") div = val;
+    else if (key == "fp") fp = val;
+    else if (key == "load") load = val;
+    else if (key == "store") store = val;
+    else if (key == "branch") branch = val;
+    else if (key == "csr") csr = val;
+    else if (key == "xret") xret = val;
+    else if (key == "trap") trap = val;
+    else if (key == "window") window = val;
+    else if (key == "load-use") load_use = val;
+    else help();
+  }
+
+  if (!alu || !mul || !div || !fp || !load || !store || !csr || !xret)
+    help();
+}
+
+cycle_model_t::~cycle_model_t()
+{
+  print_stats();
+}
+
+void cycle_model_t::print_stats()
+{
+  std::cout << "Cycle Model Instructions:     " << retired << std::endl;
+  std::cout << "Cycle Model Cycles:           " << retired + total_extra_cycles << std::endl;
+  for (int e = 0; e < N_EVENTS; e++)
+    std::cout << "Cycle Model " << event_names[e] << " " << total_event_cycles[e] << std::endl;
+}
+
+void cycle_model_t::retire(insn_t insn, reg_t pc, reg_t npc)
+{
+  const insn_bits_t bits = insn.bits();
+  reg_t latency = alu;
+  event_t latency_event = N_EVENTS;
+  reg_t load_rd = 0;
+  // Integer source registers; 0 means "none", since x0 never interlocks.
+  reg_t src1 = 0, src2 = 0;
+
+  retired++;
+
+  if ((bits & 3) != 3) {
+    const unsigned funct3 = (bits >> 13) & 7;
+    const reg_t r_hi = (bits >> 7) & 0x1f;   // rd/rs1 in CR/CI formats
+    const reg_t r_lo = (bits >> 2) & 0x1f;   // rs2 in CR/CSS formats
+    const reg_t rp_hi = 8 + ((bits >> 7) & 7); // rs1'/rd' in CL/CS/CB formats
+    const reg_t rp_lo = 8 + ((bits >> 2) & 7); // rs2'/rd' in CL/CS/CA formats
+    switch (bits & 3) {
+      case 0:
+        src1 = rp_hi;
+        if (funct3 >= 1 && funct3 <= 3) {
+          latency = load;
+          latency_event = EVENT_MEMORY;
+          load_rd = funct3 != 1 ? rp_lo : 0; // c.fld writes an FPR
+        } else if (funct3 >= 5 || (funct3 == 4 && (bits & 0x800))) {
+          latency = store;
+          latency_event = EVENT_MEMORY;
+          src2 = rp_lo;
+        } else if (funct3 == 4) {
+          latency = load;
+          latency_event = EVENT_MEMORY;
+          load_rd = rp_lo;
+        } else {
+          src1 = X_SP;
+        }
+        break;
+      case 1:
+        if (funct3 == 5) {
+          // c.j has no register operands
+        } else if (funct3 >= 4) {
+          src1 = rp_hi;
+          src2 = funct3 == 4 ? rp_lo : 0;
+        } else if (funct3 != 2) {
+          src1 = r_hi;
+        }
+        break;
+      case 2:
+        if (funct3 >= 1 && funct3 <= 3) {
+          latency = load;
+          latency_event = EVENT_MEMORY;
+          src1 = X_SP;
+          load_rd = funct3 != 1 ? r_hi : 0; // c.fldsp writes an FPR
+        } else if (funct3 >= 5) {
+          latency = store;
+          latency_event = EVENT_MEMORY;
+          src1 = X_SP;
+          src2 = r_lo;
+        } else {
+          src1 = r_hi;
+          src2 = funct3 == 4 ? r_lo : 0;
+        }
+        break;
+    }
+  } else {
+    const reg_t rd = (bits >> 7) & 0x1f;
+    const reg_t rs1 = (bits >> 15) & 0x1f;
+    const reg_t rs2 = (bits >> 20) & 0x1f;
+    const unsigned funct3 = (bits >> 12) & 7;
+    switch (bits & 0x7f) {
+      case 0x03: // LOAD
+        latency = load;
+        latency_event = EVENT_MEMORY;
+        load_rd = rd;
+        src1 = rs1;
+        break;
+      case 0x07: // LOAD-FP
+        latency = load;
+        latency_event = EVENT_MEMORY;
+        src1 = rs1;
+        break;
+      case 0x23: // STORE
+        latency = store;
+        latency_event = EVENT_MEMORY;
+        src1 = rs1;
+        src2 = rs2;
+        break;
+      case 0x27: // STORE-FP
+        latency = store;
+        latency_event = EVENT_MEMORY;
+        src1 = rs1;
+        break;
+      case 0x2f: // AMO
+        latency = load + store - 1;
+        latency_event = EVENT_MEMORY;
+        load_rd = rd;
+        src1 = rs1;
+        src2 = rs2;
+        break;
+      case 0x33: // OP
+      case 0x3b: // OP-32
+        if ((bits >> 25) == 1)
+          latency = funct3 < 4 ? mul : div;
+        src1 = rs1;
+        src2 = rs2;
+        break;
+      case 0x43: case 0x47: case 0x4b: case 0x4f: case 0x53: // OP-FP
+        latency = fp;
+        break;
+      case 0x63: // BRANCH
+        src1 = rs1;
+        src2 = rs2;
+        break;
+      case 0x37: case 0x17: case 0x6f: // LUI, AUIPC, JAL
+        break;
+      case 0x73: // SYSTEM
+        if (bits == MATCH_MRET || bits == MATCH_SRET || bits == MATCH_MNRET) {
+          latency = xret;
+          latency_event = EVENT_XRET;
+        } else if (funct3 != 0 && funct3 != 4) {
+          latency = csr;
+          src1 = funct3 < 4 ? rs1 : 0;
+        }
+        break;
+      default:
+        src1 = rs1;
+        break;
+    }
+  }
+
+  if (load_use && pending_load_rd && (src1 == pending_load_rd || src2 == pending_load_rd))
+    charge(EVENT_LOAD_USE_STALL, load_use);
+  pending_load_rd = load_rd;
+
+  charge_extra(latency);
+  if (latency_event != N_EVENTS) {
+    event_cycles[latency_event] += latency;
+    total_event_cycles[latency_event] += latency;
+  }
+
+  // Any redirect other than a return from trap costs a pipeline refill.
+  if (npc != pc + insn_length(bits) && latency_event != EVENT_XRET)
+    charge(EVENT_BRANCH, branch);
+}
@@ -0,0 +1,76 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_CYCLE_MODEL_H
+#define _RISCV_CYCLE_MODEL_H
+
+#include "decode.h"
+#include <cstdint>
+
+// Per-instruction timing model used in place of the CPI=1 mcycle bump.
+//
+// The model charges each retired instruction a latency based on its class,
+// plus fixed costs for trap entry, xRET, and register-window switches.  An
+// optional in-order load-use interlock adds stall cycles when an instruction
+// consumes the destination of the load immediately before it.  Cycles beyond
+// one per retired instruction accumulate until the end of each simulation
+// chunk, when processor_t::step() folds them into mcycle and the HPM counters.
+class cycle_model_t
+{
+ public:
+  // Cycle categories reported through mhpmcounter3 onwards.
+  enum event_t {
+    EVENT_LOAD_USE_STALL,
+    EVENT_TRAP_ENTRY,
+    EVENT_XRET,
+    EVENT_WINDOW_SWITCH,
+    EVENT_MEMORY,
+    EVENT_BRANCH,
+    EVENT_WINDOW_SPILL,
+    N_EVENTS
+  };
+
+  explicit cycle_model_t(const char* config);
+  ~cycle_model_t();
+
+  void retire(insn_t insn, reg_t pc, reg_t npc);
+  void trap_entry() { pending_load_rd = 0; charge(EVENT_TRAP_ENTRY, trap); }
+  void window_switch() { charge(EVENT_WINDOW_SWITCH, window); }
+  void window_spill(reg_t cycles) { charge(EVENT_WINDOW_SPILL, cycles); }
+
+  reg_t load_latency() const { return load; }
+  reg_t store_latency() const { return store; }
+
+  // Cycles charged since the last call, beyond one per retired instruction.
+  reg_t take_extra_cycles() { reg_t c = extra_cycles; extra_cycles = 0; return c; }
+  reg_t take_event_cycles(event_t e) { reg_t c = event_cycles[e]; event_cycles[e] = 0; return c; }
+
+  void print_stats();
+
+ private:
+  void charge(event_t e, reg_t cycles) {
+    extra_cycles += cycles;
+    total_extra_cycles += cycles;
+    event_cycles[e] += cycles;
+    total_event_cycles[e] += cycles;
+  }
+  void charge_extra(reg_t latency) {
+    extra_cycles += latency - 1;
+    total_extra_cycles += latency - 1;
+  }
+
+  // Latencies, in cycles.  Instruction latencies include the issue cycle.
+  reg_t alu, mul, div, fp, load, store, branch, csr, xret;
+  // Fixed penalties added on top of the instruction that caused them.
+  reg_t trap, window, load_use;
+
+  reg_t extra_cycles;
+  reg_t event_cycles[N_EVENTS];
+  reg_t total_event_cycles[N_EVENTS];
+  reg_t total_extra_cycles;
+  reg_t retired;
+
+  // Destination of the previous instruction if it was a load, else 0.
+  reg_t pending_load_rd;
+};
+
+#endif
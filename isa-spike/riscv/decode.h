@@ -8,6 +8,7 @@
 #include "../softfloat/softfloat_types.h"
 #include <algorithm>
 #include <cstdint>
+#include <cstdlib>
 #include <string.h>
 #include <strings.h>
 #include <cinttypes>
@@ -17,8 +18,13 @@ typedef int64_t sreg_t;
 typedef uint64_t reg_t;
 typedef float128_t freg_t;
 
-const int NXPR = 64;
+const int NXPR = 32;
 const int NFPR = 32;
+// Physical integer registers backing the XPR windows (see --phys-regs).
+const size_t NXPR_PHYS_DEFAULT = 64;
+const size_t NXPR_PHYS_MAX = 4096;
+// Physical FP registers backing the FPR windows (see --phys-fregs).
+const size_t NFPR_PHYS_DEFAULT = NFPR;
 const int NVPR = 32;
 const int NCSR = 4096;
 
@@ -215,62 +221,89 @@ private:
 };
 
 // [VARIABLE WINDOW REGISTER FILE]
+// N architectural registers are windowed onto a physical file whose size
+// is chosen at runtime (see resize()).  Physical storage is a
+// cache-line-aligned array with two extra slots: one that always reads as
+// zero and one that absorbs discarded writes.  set_window_config()
+// precomputes the physical slot of every logical register, so reads and
+// writes are a single indexed access: out-of-window reads (and x0) see the
+// zero slot, and out-of-window writes (and writes to x0) land in the sink
+// slot.  Window bases and sizes are rounded down to a multiple of the
+// window granularity.
 template <class T, size_t N, bool zero_reg>
 class regfile_t
 {
 public:
-  // Default to full size (32) if not specified
-  regfile_t() : data(N), base_offset(0), window_size(N) { reset(); }
+  regfile_t() : data(nullptr), granularity(1) { resize(N); }
+  ~regfile_t() { free(data); }
+  regfile_t(const regfile_t&) = delete;
+  regfile_t& operator=(const regfile_t&) = delete;
+
+  // Reallocate the physical file with n registers and reset it.
+  void resize(size_t n, size_t window_granularity = 1)
+  {
+    size_t bytes = (n + 2) * sizeof(T);
+    free(data);
+    data = static_cast<T*>(aligned_alloc(64, (bytes + 63) & ~size_t(63)));
+    phys_size = n;
+    granularity = window_granularity;
+    reset();
+  }
+
+  size_t size() const { return phys_size; }
+  size_t get_granularity() const { return granularity; }
 
   void set_window_config(size_t base, size_t size) {
-      if (base < N) base_offset = base;
-      // Clamp size so (Base + Size) doesn't exceed Physical N
-      if (base + size > N) window_size = N - base; 
-      else window_size = size;
+      base -= base % granularity;
+      size = std::max(size - size % granularity, granularity);
+      if (base < phys_size) base_offset = base;
+      // Clamp size so (Base + Size) doesn't exceed the physical file
+      window_size = std::min(size, phys_size - base_offset);
+      remap();
   }
-  
+
   size_t get_base_offset() const { return base_offset; }
   size_t get_window_size() const { return window_size; }
 
   void write(size_t i, T value)
   {
-    // x0 is always 0
-    if (zero_reg && i == 0) return;
-
-    // [SECURITY] Hardware Boundary Check
-    // If Task 1 (Size 5) tries to write x5, we silently drop it.
-    if (i >= window_size) return; 
-
-    size_t physical_index = i + base_offset;
-    if (physical_index < data.size()) {
-        data[physical_index] = value;
-    }
+    data[write_map[i]] = value;
   }
 
   const T& operator [] (size_t i) const
   {
-    if (zero_reg && i == 0) return data[0];
-
-    // [SECURITY] Read Out of Bounds returns 0
-    if (i >= window_size) return data[0];
-
-    size_t physical_index = i + base_offset;
-    if (physical_index >= data.size()) return data[0];
-
-    return data[physical_index];
+    return data[read_map[i]];
   }
 
+  // Direct access to physical register p, bypassing the window.
+  const T& phys(size_t p) const { return data[p]; }
+  void write_phys(size_t p, T value) { data[p] = value; }
+
   void reset()
   {
-    data.assign(N, T());
+    std::fill(data, data + phys_size + 2, T());
     base_offset = 0;
-    window_size = N;
+    window_size = phys_size;
+    remap();
   }
 
 private:
-  std::vector<T> data;
+  void remap()
+  {
+    for (size_t i = 0; i < N; i++) {
+      bool visible = i < window_size && !(zero_reg && i == 0);
+      read_map[i] = visible ? i + base_offset : phys_size;
+      write_map[i] = visible ? i + base_offset : phys_size + 1;
+    }
+  }
+
+  T* data;
+  uint16_t read_map[N];
+  uint16_t write_map[N];
+  size_t phys_size;
+  size_t granularity;
   size_t base_offset;
-  size_t window_size; // [NEW] Track active window size
+  size_t window_size;
 };
 
 #define get_field(reg, mask) \
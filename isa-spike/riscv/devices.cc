@@ -1,6 +1,11 @@
 #include "devices.h"
 #include "mmu.h"
 #include <stdexcept>
+#include <sys/mman.h>
+
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
 
 mmio_device_map_t& mmio_device_map()
 {
@@ -96,15 +101,45 @@ std::pair<reg_t, abstract_device_t*> bus_t::find_device(reg_t addr, size_t len)
   return std::make_pair(0, fallback);
 }
 
-mem_t::mem_t(reg_t size)
-  : sz(size)
+mem_t::mem_t(reg_t size, mem_backing_t backing)
+  : flat(NULL), flat_len(0), sz(size)
 {
   if (size == 0 || size % PGSIZE != 0)
     throw std::runtime_error("memory size must be a positive multiple of 4 KiB");
+
+  if (backing == mem_backing_sparse)
+    return;
+
+  // Map the whole region up front and let the OS zero pages as they are
+  // first touched.  Huge pages come from the hugetlb pool if it has enough
+  // for all of it, which the mapping reserves, else from transparent huge
+  // pages.
+  void* p = MAP_FAILED;
+  int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_HUGETLB
+  if (backing == mem_backing_huge) {
+    const size_t huge_page_size = size_t(2) << 20;
+    flat_len = (size + huge_page_size - 1) & ~(huge_page_size - 1);
+    p = mmap(NULL, flat_len, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+  }
+#endif
+  if (p == MAP_FAILED) {
+    flat_len = size;
+    p = mmap(NULL, flat_len, PROT_READ | PROT_WRITE, flags | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED)
+      throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+    if (backing == mem_backing_huge)
+      madvise(p, flat_len, MADV_HUGEPAGE);
+#endif
+  }
+  flat = (char*)p;
 }
 
 mem_t::~mem_t()
 {
+  if (flat)
+    munmap(flat, flat_len);
   for (auto& entry : sparse_memory_map)
     free(entry.second);
 }
@@ -131,6 +166,9 @@ bool mem_t::load_store(reg_t addr, size_t len, uint8_t* bytes, bool store)
 }
 
 char* mem_t::contents(reg_t addr) {
+  if (flat)
+    return flat + addr;
+
   reg_t ppn = addr >> PGSHIFT, pgoff = addr % PGSIZE;
   auto search = sparse_memory_map.find(ppn);
   if (search == sparse_memory_map.end()) {
@@ -144,6 +182,11 @@ char* mem_t::contents(reg_t addr) {
 }
 
 void mem_t::dump(std::ostream& o) {
+  if (flat) {
+    o.write(flat, sz);
+    return;
+  }
+
   const char empty[PGSIZE] = {0};
   for (reg_t i = 0; i < sz; i += PGSIZE) {
     reg_t ppn = i >> PGSHIFT;
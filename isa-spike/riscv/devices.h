@@ -5,6 +5,7 @@
 #include "abstract_device.h"
 #include "abstract_interrupt_controller.h"
 #include "platform.h"
+#include "cfg.h"
 #include <map>
 #include <queue>
 #include <vector>
@@ -50,11 +51,14 @@ class abstract_mem_t : public abstract_device_t {
 
   virtual char* contents(reg_t addr) = 0;
   virtual void dump(std::ostream& o) = 0;
+
+  // The whole region, if it is contiguous in host memory, else NULL
+  virtual char* flat_contents() { return NULL; }
 };
 
 class mem_t : public abstract_mem_t {
  public:
-  mem_t(reg_t size);
+  mem_t(reg_t size, mem_backing_t backing = mem_backing_sparse);
   mem_t(const mem_t& that) = delete;
   ~mem_t() override;
 
@@ -63,11 +67,14 @@ class mem_t : public abstract_mem_t {
   char* contents(reg_t addr) override;
   reg_t size() override { return sz; }
   void dump(std::ostream& o) override;
+  char* flat_contents() override { return flat; }
 
  private:
   bool load_store(reg_t addr, size_t len, uint8_t* bytes, bool store);
 
   std::map<reg_t, char*> sparse_memory_map;
+  char* flat;
+  size_t flat_len;
   reg_t sz;
 };
 
@@ -97,6 +104,7 @@ class clint_t : public abstract_device_t {
   bool store(reg_t addr, size_t len, const uint8_t* bytes) override;
   reg_t size() override { return CLINT_SIZE; }
   void tick(reg_t rtc_ticks) override;
+  reg_t next_event() override;
   uint64_t get_mtimecmp(reg_t hartid) { return mtimecmp[hartid]; }
   uint64_t get_mtime() { return mtime; }
  private:
@@ -113,6 +121,7 @@ class clint_t : public abstract_device_t {
 };
 
 #define PLIC_MAX_DEVICES 1024
+#define PLIC_MAX_PRIO ((1U << PLIC_PRIO_BITS) - 1)
 
 struct plic_context_t {
   plic_context_t(processor_t* proc, bool mmode)
@@ -127,6 +136,13 @@ struct plic_context_t {
   uint32_t pending[PLIC_MAX_DEVICES/32] {};
   uint8_t pending_priority[PLIC_MAX_DEVICES] {};
   uint32_t claimed[PLIC_MAX_DEVICES/32] {};
+
+  // Pending, unclaimed IDs bucketed by pending priority, with a bit per
+  // nonempty word and per nonempty bucket, so that the best pending ID is
+  // found with a couple of ctz operations.
+  uint32_t ready[PLIC_MAX_PRIO + 1][PLIC_MAX_DEVICES/32] {};
+  uint32_t ready_words[PLIC_MAX_PRIO + 1] {};
+  uint32_t ready_prios {};
 };
 
 class plic_t : public abstract_device_t, public abstract_interrupt_controller_t {
@@ -144,6 +160,8 @@ class plic_t : public abstract_device_t, public abstract_interrupt_controller_t
   uint8_t priority[PLIC_MAX_DEVICES];
   uint32_t level[PLIC_MAX_DEVICES/32];
   uint32_t context_best_pending(const plic_context_t *c);
+  void context_set_ready(plic_context_t *c, uint32_t id, bool ready);
+  void context_set_pending(plic_context_t *c, uint32_t id, bool pending);
   void context_update(const plic_context_t *context);
   uint32_t context_claim(plic_context_t *c);
   bool priority_read(reg_t offset, uint32_t *val);
@@ -159,6 +177,60 @@ class plic_t : public abstract_device_t, public abstract_interrupt_controller_t
                      reg_t offset, uint32_t val);
 };
 
+#define CLIC_MAX_SOURCES 1024
+#define CLIC_FIRST_SOURCE 16 // causes below are the standard mip interrupts
+
+// Per-source attributes (clicintattr)
+#define CLIC_ATTR_SHV  0x1 // jump straight to the source's vector
+#define CLIC_ATTR_EDGE 0x2 // edge-triggered: pending clears when taken
+
+#define MCAUSE_MPIL    0x00FF0000 // interrupted level, saved on M-mode trap entry
+
+struct clic_source_t {
+  uint8_t ip {};
+  uint8_t ie {};
+  uint8_t attr {};
+  uint8_t ctl {};       // [level | priority], split by cliccfg.nlbits
+  reg_t vector {};      // handler address when CLIC_ATTR_SHV is set
+  uint32_t window {};   // trap window, [size | base]; 0 for the default
+};
+
+// The hart-local half of the CLIC.  processor_t polls best_id, which
+// update() keeps current, and calls claim() when it takes the interrupt.
+struct clic_context_t {
+  clic_context_t(processor_t* proc, uint32_t num_ids)
+    : proc(proc), sources(num_ids)
+  {}
+
+  processor_t *proc;
+  uint8_t nlbits {};    // cliccfg
+  uint8_t threshold {}; // mintthresh
+  uint8_t level {};     // level of the running handler, 0 outside handlers
+  std::vector<clic_source_t> sources;
+  uint32_t best_id {};  // highest-ranked pending and enabled source, or 0
+
+  uint8_t level_of(uint8_t ctl) const;
+  bool interrupt_ready() const {
+    return best_id && level_of(sources[best_id].ctl) > std::max(level, threshold);
+  }
+  void update();
+  // Take interrupt id: sets the handler level and returns the previous one.
+  uint8_t claim(uint32_t id);
+};
+
+class clic_t : public abstract_device_t {
+ public:
+  clic_t(const simif_t*, uint32_t ndev);
+  bool load(reg_t addr, size_t len, uint8_t* bytes) override;
+  bool store(reg_t addr, size_t len, const uint8_t* bytes) override;
+  reg_t size() override { return contexts.size() * CLIC_HART_SIZE; }
+ private:
+  std::vector<clic_context_t> contexts;
+  uint32_t num_ids;
+  bool reg_read(clic_context_t* c, reg_t offset, uint8_t* val);
+  bool reg_write(clic_context_t* c, reg_t offset, uint8_t val);
+};
+
 class ns16550_t : public abstract_device_t {
  public:
   ns16550_t(abstract_interrupt_controller_t *intctrl,
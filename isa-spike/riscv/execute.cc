@@ -5,6 +5,7 @@
 #include "mmu.h"
 #include "disasm.h"
 #include "decode_macros.h"
+#include "commit_trace.h"
 #include <cassert>
 
 static void commit_log_reset(processor_t* p)
@@ -59,8 +60,60 @@ static void commit_log_print_value(FILE *log_file, int width, uint64_t val)
   commit_log_print_value(log_file, width, &val);
 }
 
+// The --commit-trace equivalent of commit_log_print_insn.
+static void commit_log_trace_insn(processor_t *p, commit_ring_t *ring, reg_t pc, insn_t insn)
+{
+  state_t* state = p->get_state();
+  int xlen = state->last_inst_xlen;
+  int flen = state->last_inst_flen;
+
+  ring->push({COMMIT_INSN, (uint8_t)state->last_inst_priv, (uint16_t)(xlen | flen << 8),
+              p->get_id(), pc, (uint64_t)insn.bits()});
+
+  bool show_vec = false;
+  for (auto item : state->log_reg_write) {
+    if (item.first == 0)
+      continue;
+
+    int type = item.first & 0xf;
+    uint16_t rd = item.first >> 4;
+    bool is_vreg = type == 2;
+    bool is_vec = type == 3;
+
+    if (!show_vec && (is_vreg || is_vec)) {
+      int32_t lmul = p->VU.vflmul < 1 ? -(int32_t)(1 / p->VU.vflmul) : (int32_t)p->VU.vflmul;
+      ring->push({COMMIT_VTYPE, 0, (uint16_t)p->VU.vsew, (uint32_t)lmul, p->VU.vl->read(), 0});
+      show_vec = true;
+    }
+
+    if (is_vreg) {
+      reg_t vlenb = p->VU.VLEN / 8;
+      const uint8_t* data = &p->VU.elt<uint8_t>(rd, 0);
+      ring->push({COMMIT_VREG, 0, rd, (uint32_t)p->VU.VLEN, 0, 0});
+      for (reg_t i = 0; i < vlenb; i += 16) {
+        uint64_t chunk[2] = { 0, 0 };
+        memcpy(chunk, data + i, std::min(vlenb - i, reg_t(16)));
+        ring->push({COMMIT_DATA, 0, 0, 0, chunk[0], chunk[1]});
+      }
+    } else if (!is_vec) {
+      ring->push({COMMIT_REG, (uint8_t)type, rd, 0, item.second.v[0], item.second.v[1]});
+    }
+  }
+
+  for (auto item : state->log_mem_read)
+    ring->push({COMMIT_LOAD, 0, 0, 0, std::get<0>(item), 0});
+
+  for (auto item : state->log_mem_write)
+    ring->push({COMMIT_STORE, std::get<2>(item), 0, 0, std::get<0>(item), std::get<1>(item)});
+
+  ring->publish();
+}
+
 static void commit_log_print_insn(processor_t *p, reg_t pc, insn_t insn)
 {
+  if (p->get_commit_ring())
+    return commit_log_trace_insn(p, p->get_commit_ring(), pc, insn);
+
   FILE *log_file = p->get_log_file();
 
   auto& reg = p->get_state()->log_reg_write;
@@ -204,13 +257,16 @@ static inline reg_t execute_insn_logged(processor_t* p, reg_t pc, insn_fetch_t f
 bool processor_t::slow_path() const
 {
   return debug || state.single_step != state.STEP_NONE || state.debug_mode ||
-         log_commits_enabled || histogram_enabled || in_wfi || check_triggers_icount;
+         (log_commits_enabled && !commit_ring) || histogram_enabled || in_wfi || check_triggers_icount ||
+         cycle_model;
 }
 
 // fetch/decode/execute loop
-void processor_t::step(size_t n)
+size_t processor_t::step(size_t n)
 {
   mmu_t* _mmu = mmu;
+  const size_t requested = n;
+  yield_requested = false;
 
   if (!state.debug_mode) {
     if (halt_request == HR_REGULAR) {
@@ -229,6 +285,28 @@ void processor_t::step(size_t n)
     state.prv_changed = false;
     state.v_changed = false;
 
+    // The icache-chained fast path.  A binary commit trace runs it with
+    // execute_insn_logged, since it needs no formatting on this thread.
+    #define fast_path(execute_insn) \
+      while (instret < n && !yield_requested) { \
+        for (auto ic_entry = _mmu->access_icache(pc); instret < n; instret++) { \
+          auto fetch = ic_entry->data; \
+          auto last_entry = ic_entry; \
+          ic_entry = ic_entry->next; \
+          auto new_pc = execute_insn(this, pc, fetch); \
+          if (unlikely(ic_entry->tag != new_pc)) { \
+            ic_entry = _mmu->icache_way(new_pc); \
+            last_entry->next = ic_entry; \
+            if (ic_entry->tag != new_pc) { \
+              pc = new_pc; \
+              advance_pc(); \
+              break; \
+            } \
+          } \
+          state.pc = pc = ic_entry->tag; \
+        } \
+      }
+
     #define advance_pc() { \
       if (unlikely(invalid_pc(pc))) { \
         switch (pc) { \
@@ -252,7 +330,7 @@ void processor_t::step(size_t n)
       if (unlikely(slow_path()))
       {
         // Main simulation loop, slow path.
-        while (instret < n)
+        while (instret < n && !yield_requested)
         {
           if (unlikely(!state.serialized && state.single_step == state.STEP_STEPPED)) {
             state.single_step = state.STEP_NONE;
@@ -284,7 +362,10 @@ void processor_t::step(size_t n)
           insn_fetch_t fetch = mmu->load_insn(pc);
           if (debug && !state.serialized)
             disasm(fetch.insn);
-          pc = execute_insn_logged(this, pc, fetch);
+          reg_t npc = execute_insn_logged(this, pc, fetch);
+          if (cycle_model && npc != PC_SERIALIZE_BEFORE)
+            cycle_model->retire(fetch.insn, pc, invalid_pc(npc) ? state.pc : npc);
+          pc = npc;
           advance_pc();
 
           // Resume from debug mode in critical error
@@ -299,23 +380,32 @@ void processor_t::step(size_t n)
           }
         }
       }
-      else while (instret < n)
+      // Main simulation loop, fast path.  yield() flushes the icache, so it
+      // gets here right after the yielding instruction.
+      else if (unlikely(commit_ring != NULL))
       {
-        // Main simulation loop, fast path.
-        for (auto ic_entry = _mmu->access_icache(pc); instret < n; instret++) {
-          auto fetch = ic_entry->data;
-          ic_entry = ic_entry->next;
-          auto new_pc = execute_insn_fast(this, pc, fetch);
-          if (unlikely(ic_entry->tag != new_pc)) {
-            ic_entry = &_mmu->icache[_mmu->icache_index(new_pc)];
-            _mmu->icache[_mmu->icache_index(pc)].next = ic_entry;
-            if (ic_entry->tag != new_pc) {
-              pc = new_pc;
-              advance_pc();
-              break;
-            }
+        fast_path(execute_insn_logged);
+      }
+      else if (unlikely(!_mmu->block_cache_usable()))
+      {
+        fast_path(execute_insn_fast);
+      }
+      else while (instret < n && !yield_requested)
+      {
+        // Run a basic block until it branches out or the caches are flushed,
+        // e.g. by fence.i or a store to this page under Ziccid.
+        block_entry_t* b = _mmu->access_block(pc);
+        const reg_t tag = pc;
+        const size_t len = std::min(b->len, n - instret);
+        for (size_t i = 0; i < len; i++) {
+          auto new_pc = execute_insn_fast(this, pc, b->insns[i].fetch);
+          if (unlikely(new_pc != b->insns[i].npc || b->tag != tag)) {
+            pc = new_pc;
+            advance_pc();
+            break;
           }
-          state.pc = pc = ic_entry->tag;
+          state.pc = pc = new_pc;
+          instret++;
         }
       }
     }
@@ -364,11 +454,28 @@ void processor_t::step(size_t n)
     }
 
 serialize:
-    state.minstret->bump((state.mcountinhibit->read() & MCOUNTINHIBIT_IR) ? 0 : instret);
-
-    // Model a hart whose CPI is 1.
-    state.mcycle->bump((state.mcountinhibit->read() & MCOUNTINHIBIT_CY) ? 0 : instret);
+    reg_t retired = instret + emulated_instret;
+    emulated_instret = 0;
+    state.minstret->bump((state.mcountinhibit->read() & MCOUNTINHIBIT_IR) ? 0 : retired);
+
+    // Model a hart whose CPI is 1, unless a cycle model charges extra cycles.
+    reg_t cycles = retired;
+    if (cycle_model) {
+      cycles += cycle_model->take_extra_cycles();
+      for (int i = 0; i < cycle_model_t::N_EVENTS; i++) {
+        reg_t event_cycles = cycle_model->take_event_cycles(cycle_model_t::event_t(i));
+        bool inhibit = state.mcountinhibit->read() & (reg_t(1) << (FIRST_HPMCOUNTER + i));
+        state.mhpmcounter[i]->bump(inhibit ? 0 : event_cycles);
+      }
+    }
+    state.mcycle->bump((state.mcountinhibit->read() & MCOUNTINHIBIT_CY) ? 0 : cycles);
+    if (switch_profiler)
+      switch_profiler->advance(retired, cycles);
 
     n -= instret;
+    if (unlikely(yield_requested))
+      break;
   }
+
+  return requested - n;
 }
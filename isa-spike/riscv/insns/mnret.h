@@ -17,4 +17,5 @@ if (p->extension_enabled(EXT_ZICFILP)) {
   s = set_field(s, MNSTATUS_MNPELP, elp_t::NO_LP_EXPECTED);
 }
 STATE.mnstatus->write(s);
+p->get_window_ctrl()->trap_return();
 p->set_privilege(prev_prv, prev_virt);
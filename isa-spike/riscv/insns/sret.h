@@ -44,4 +44,5 @@ if (STATE.prv == PRV_S) {
 }
 
 STATE.sstatus->write(s);
+p->get_window_ctrl()->trap_return();
 p->set_privilege(prev_prv, prev_virt);
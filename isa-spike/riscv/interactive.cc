@@ -275,6 +275,7 @@ void sim_t::interactive()
   funcs["rs"] = &sim_t::interactive_run_silent;
   funcs["vreg"] = &sim_t::interactive_vreg;
   funcs["reg"] = &sim_t::interactive_reg;
+  funcs["regfile"] = &sim_t::interactive_regfile;
   funcs["freg"] = &sim_t::interactive_freg;
   funcs["fregh"] = &sim_t::interactive_fregh;
   funcs["fregs"] = &sim_t::interactive_fregs;
@@ -367,6 +368,7 @@ void sim_t::interactive_help(const std::string& cmd, const std::vector<std::stri
   out <<
     "Interactive commands:\n"
     "reg <core> [reg]                # Display [reg] (all if omitted) in <core>\n"
+    "regfile <core>                  # Display the whole physical register file in <core>\n"
     "freg <core> <reg>               # Display float <reg> in <core> as hex\n"
     "fregh <core> <reg>              # Display half precision <reg> in <core>\n"
     "fregs <core> <reg>              # Display single precision <reg> in <core>\n"
@@ -631,6 +633,15 @@ void sim_t::interactive_reg(const std::string& cmd, const std::vector<std::strin
   }
 }
 
+void sim_t::interactive_regfile(const std::string& cmd, const std::vector<std::string>& args)
+{
+  if (args.size() != 1)
+    throw trap_interactive();
+
+  std::ostream out(sout_.rdbuf());
+  get_core(args[0])->dump_regfile(out);
+}
+
 union fpr
 {
   freg_t r;
@@ -24,6 +24,20 @@ mmu_t::mmu_t(simif_t* sim, endianness_t endianness, processor_t* proc, reg_t cac
 #ifndef RISCV_ENABLE_DUAL_ENDIAN
   assert(endianness == endianness_little);
 #endif
+  const cfg_t& cfg = sim->get_cfg();
+  icache.resize(cfg.icache_entries);
+  icache_ways = cfg.icache_ways;
+  icache_set_mask = cfg.icache_entries / cfg.icache_ways - 1;
+  icache_victim = 0;
+  icache_stats = {};
+  tlb_load.resize(cfg.tlb_entries);
+  tlb_store.resize(cfg.tlb_entries);
+  tlb_insn.resize(cfg.tlb_entries);
+  tlb_ways = cfg.tlb_ways;
+  tlb_set_mask = cfg.tlb_entries / cfg.tlb_ways - 1;
+  tlb_victim = 0;
+  memset(tlb_stats, 0, sizeof(tlb_stats));
+
   flush_tlb();
   yield_load_reservation();
 }
@@ -34,15 +48,55 @@ mmu_t::~mmu_t()
 
 void mmu_t::flush_icache()
 {
-  for (size_t i = 0; i < ICACHE_ENTRIES; i++)
-    icache[i].tag = -1;
+  for (auto& entry : icache)
+    entry.tag = -1;
+  for (size_t i = 0; i < BLOCK_ENTRIES; i++)
+    blocks[i].tag = -1;
+}
+
+// The first instruction is fetched as usual, and may trap.  The ones after
+// it are only taken while they are on the same page, entirely, and that page
+// is plain memory in the fetch TLB with nothing tracing or triggering on it,
+// so that looking ahead has no side effects.  A block ends after a jal or
+// jalr, since nothing after them runs straight on.
+block_entry_t* mmu_t::refill_block(reg_t addr, block_entry_t* b)
+{
+  b->tag = -1;
+  b->len = 0;
+
+  icache_entry_t* entry = access_icache(addr);
+  reg_t pc = addr;
+  while (true) {
+    insn_t insn = entry->data.insn;
+    b->insns[b->len++] = {entry->data, pc + insn.length()};
+    if (entry->tag != pc) // the tracer wants to see every fetch of it
+      return b;
+
+    reg_t opcode = insn.bits() & 0x7f;
+    pc += insn.length();
+    if (b->len == block_entry_t::MAX_INSNS || opcode == 0x6f || opcode == 0x67 ||
+        pc / PGSIZE != addr / PGSIZE)
+      break;
+
+    auto [tlb_hit, host_addr, _] = access_tlb(tlb_insn, pc);
+    if (!tlb_hit)
+      break;
+    insn_parcel_t parcel;
+    memcpy(&parcel, (char*)host_addr, sizeof(parcel));
+    if (pc % PGSIZE + insn_length(from_le(parcel)) > PGSIZE)
+      break;
+    entry = access_icache(pc);
+  }
+
+  b->tag = addr;
+  return b;
 }
 
 void mmu_t::flush_tlb()
 {
-  memset(tlb_insn, -1, sizeof(tlb_insn));
-  memset(tlb_load, -1, sizeof(tlb_load));
-  memset(tlb_store, -1, sizeof(tlb_store));
+  memset(tlb_insn.data(), -1, tlb_insn.size() * sizeof(dtlb_entry_t));
+  memset(tlb_load.data(), -1, tlb_load.size() * sizeof(dtlb_entry_t));
+  memset(tlb_store.data(), -1, tlb_store.size() * sizeof(dtlb_entry_t));
   memset(pte_cache, -1, sizeof(pte_cache));
 
   flush_icache();
@@ -106,6 +160,7 @@ mmu_t::insn_parcel_t mmu_t::fetch_slow_path(reg_t vaddr)
 
   if  (auto [tlb_hit, host_addr, paddr] = access_tlb(tlb_insn, vaddr, TLB_FLAGS & ~TLB_CHECK_TRIGGERS); tlb_hit) {
     // Fast path for simple cases
+    tlb_stats[FETCH].hits++;
     return perform_intrapage_fetch(vaddr, host_addr, paddr);
   }
 
@@ -129,6 +184,8 @@ mmu_t::insn_parcel_t mmu_t::fetch_slow_path(reg_t vaddr)
     }
 
     refill_tlb(vaddr, paddr, (char*)host_addr, FETCH);
+  } else {
+    tlb_stats[FETCH].hits++;
   }
 
   auto res = perform_intrapage_fetch(vaddr, host_addr, paddr);
@@ -283,6 +340,8 @@ void mmu_t::load_slow_path_intrapage(reg_t len, uint8_t* bytes, mem_access_info_
 
     if (!special)
       refill_tlb(vaddr, paddr, (char*)host_addr, LOAD);
+  } else {
+    tlb_stats[LOAD].hits++;
   }
 
   if (access_info.flags.lr && !sim->reservable(paddr)) {
@@ -379,6 +438,8 @@ void mmu_t::store_slow_path_intrapage(reg_t len, const uint8_t* bytes, mem_acces
 
     if (!access_info.flags.is_special_access())
       refill_tlb(vaddr, paddr, (char*)host_addr, STORE);
+  } else {
+    tlb_stats[STORE].hits++;
   }
 
   if (actually_store)
@@ -441,14 +502,14 @@ void mmu_t::store_slow_path(reg_t original_addr, std::size_t len,
   }
 }
 
-bool mmu_t::flush_tlb_ppn(reg_t ppn, dtlb_entry_t* tlb, reverse_tags_t& filter)
+bool mmu_t::flush_tlb_ppn(reg_t ppn, std::vector<dtlb_entry_t>& tlb, reverse_tags_t& filter)
 {
   if (!filter.contains(ppn))
     return false;
 
   filter.clear();
 
-  for (size_t i = 0; i < TLB_ENTRIES; i++) {
+  for (size_t i = 0; i < tlb.size(); i++) {
     auto entry_ppn = tlb[i].data.target_addr >> PGSHIFT;
     if (entry_ppn == ppn)
       tlb[i].tag = -1;
@@ -470,12 +531,23 @@ void mmu_t::flush_itlb_ppn(reg_t ppn)
     flush_icache();
 }
 
+// The way already holding vpn, so that it is never cached twice, or else the
+// next one round-robin.
+reg_t mmu_t::tlb_refill_way(const std::vector<dtlb_entry_t>& tlb, reg_t vpn)
+{
+  reg_t idx = tlb_way(tlb, vpn);
+  if ((tlb[idx].tag & ~TLB_FLAGS) == vpn)
+    return idx;
+  return idx + tlb_victim++ % tlb_ways;
+}
+
 tlb_entry_t mmu_t::refill_tlb(reg_t vaddr, reg_t paddr, char* host_addr, access_type type)
 {
-  reg_t idx = (vaddr >> PGSHIFT) % TLB_ENTRIES;
   reg_t expected_tag = vaddr >> PGSHIFT;
   reg_t base_paddr = paddr & ~reg_t(PGSIZE - 1);
 
+  tlb_stats[type].misses++;
+
   tlb_entry_t entry = {uintptr_t(host_addr) - (vaddr % PGSIZE), paddr - (vaddr % PGSIZE)};
 
   if (in_mprv()
@@ -487,18 +559,24 @@ tlb_entry_t mmu_t::refill_tlb(reg_t vaddr, reg_t paddr, char* host_addr, access_
   auto mmio_flag = host_addr ? 0 : TLB_MMIO;
 
   switch (type) {
-    case FETCH:
+    case FETCH: {
+      reg_t idx = tlb_refill_way(tlb_insn, expected_tag);
       tlb_insn[idx].data = entry;
       tlb_insn[idx].tag = expected_tag | (check_triggers_fetch ? TLB_CHECK_TRIGGERS : 0) | trace_flag | mmio_flag;
       break;
-    case LOAD:
+    }
+    case LOAD: {
+      reg_t idx = tlb_refill_way(tlb_load, expected_tag);
       tlb_load[idx].data = entry;
       tlb_load[idx].tag = expected_tag | (check_triggers_load ? TLB_CHECK_TRIGGERS : 0) | trace_flag | mmio_flag;
       break;
-    case STORE:
+    }
+    case STORE: {
+      reg_t idx = tlb_refill_way(tlb_store, expected_tag);
       tlb_store[idx].data = entry;
       tlb_store[idx].tag = expected_tag | (check_triggers_store ? TLB_CHECK_TRIGGERS : 0) | trace_flag | mmio_flag;
       break;
+    }
     default:
       abort();
   }
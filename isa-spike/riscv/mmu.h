@@ -18,6 +18,7 @@
 #include <cassert>
 #include <cstddef>
 #include <stdlib.h>
+#include <vector>
 
 // virtual memory configuration
 #define PGSHIFT 12
@@ -50,6 +51,19 @@ struct icache_entry_t {
   insn_fetch_t data;
 };
 
+// A straight-line run of instructions from one page, decoded once, each with
+// the PC that follows it if it doesn't branch.  A tag of -1 marks a run that
+// is not cached and only its first instruction is valid to run.
+struct block_entry_t {
+  static const size_t MAX_INSNS = 8;
+  reg_t tag;
+  size_t len;
+  struct {
+    insn_fetch_t fetch;
+    reg_t npc;
+  } insns[MAX_INSNS];
+};
+
 struct tlb_entry_t {
   uintptr_t host_addr;
   reg_t target_addr;
@@ -60,6 +74,12 @@ struct dtlb_entry_t {
   reg_t tag;
 };
 
+// Lookups that found what they wanted, and ones that had to refill
+struct sim_cache_stats_t {
+  uint64_t hits;
+  uint64_t misses;
+};
+
 struct pte_cache_entry_t {
   reg_t paddr;
   reg_t pte;
@@ -108,6 +128,7 @@ public:
     auto [tlb_hit, host_addr, _] = access_tlb(tlb_load, addr);
 
     if (likely(!xlate_flags.is_special_access() && aligned && tlb_hit)) {
+      tlb_stats[LOAD].hits++;
       res = *(target_endian<T>*)host_addr;
     } else {
       load_slow_path(addr, sizeof(T), (uint8_t*)&res, xlate_flags);
@@ -120,6 +141,7 @@ public:
 
   template<typename T>
   T load_reserved(reg_t addr) {
+    auto guard = sim->atomic_lock();
     return load<T>(addr, {.lr = true});
   }
 
@@ -148,6 +170,7 @@ public:
     auto [tlb_hit, host_addr, _] = access_tlb(tlb_store, addr);
 
     if (!xlate_flags.is_special_access() && likely(aligned && tlb_hit)) {
+      tlb_stats[STORE].hits++;
       *(target_endian<T>*)host_addr = to_target(val);
     } else {
       target_endian<T> target_val = to_target(val);
@@ -168,6 +191,35 @@ public:
     store<T>(addr, val, {.ss_access=true});
   }
 
+  // Physical accesses made by the hart itself rather than by an instruction
+  // (e.g. the register window spill engine).  They bypass translation and
+  // PMP but are reported to memory tracers.  Return false if paddr is not
+  // backed by memory or a device.
+  template<typename T>
+  bool load_phys(reg_t paddr, T* val) {
+    target_endian<T> res;
+    if (void* host_addr = sim->addr_to_mem(paddr))
+      memcpy(&res, host_addr, sizeof(T));
+    else if (!mmio_load(paddr, sizeof(T), (uint8_t*)&res))
+      return false;
+    if (tracer.interested_in_range(paddr, paddr + sizeof(T), LOAD))
+      tracer.trace(paddr, sizeof(T), LOAD);
+    *val = from_target(res);
+    return true;
+  }
+
+  template<typename T>
+  bool store_phys(reg_t paddr, T val) {
+    target_endian<T> target_val = to_target(val);
+    if (void* host_addr = sim->addr_to_mem(paddr))
+      memcpy(host_addr, &target_val, sizeof(T));
+    else if (!mmio_store(paddr, sizeof(T), (const uint8_t*)&target_val))
+      return false;
+    if (tracer.interested_in_range(paddr, paddr + sizeof(T), STORE))
+      tracer.trace(paddr, sizeof(T), STORE);
+    return true;
+  }
+
   // AMO/Zicbom faults should be reported as store faults
   #define convert_load_traps_to_store_traps(BODY) \
     try { \
@@ -187,9 +239,12 @@ public:
   template<typename T, typename op>
   T amo(reg_t addr, op f) {
     convert_load_traps_to_store_traps({
+      auto guard = sim->atomic_lock();
       store_slow_path(addr, sizeof(T), nullptr, {}, false, true);
       auto lhs = load<T>(addr);
       store<T>(addr, f(lhs));
+      if (guard)
+        break_reservations(addr);
       return lhs;
     })
   }
@@ -197,19 +252,26 @@ public:
   // for shadow stack amoswap
   template<typename T>
   T ssamoswap(reg_t addr, reg_t value) {
+      auto guard = sim->atomic_lock();
       store_slow_path(addr, sizeof(T), nullptr, {.ss_access=true}, false, true);
       auto data = load<T>(addr, {.ss_access=true});
       store<T>(addr, value, {.ss_access=true});
+      if (guard)
+        break_reservations(addr);
       return data;
   }
 
   template<typename T>
   T amo_compare_and_swap(reg_t addr, T comp, T swap) {
     convert_load_traps_to_store_traps({
+      auto guard = sim->atomic_lock();
       store_slow_path(addr, sizeof(T), nullptr, {}, false, true);
       auto lhs = load<T>(addr);
-      if (lhs == comp)
+      if (lhs == comp) {
         store<T>(addr, swap);
+        if (guard)
+          break_reservations(addr);
+      }
       return lhs;
     })
   }
@@ -246,6 +308,13 @@ public:
     load_reservation_address = (reg_t)-1;
   }
 
+  // Another hart's SC or AMO stored to paddr, or somewhere if paddr is -1.
+  inline void break_load_reservation(reg_t paddr)
+  {
+    if (paddr == (reg_t)-1 || load_reservation_address / 8 == paddr / 8)
+      yield_load_reservation();
+  }
+
   inline bool check_load_reservation(reg_t vaddr, size_t size)
   {
     if (vaddr & (size-1)) {
@@ -266,21 +335,29 @@ public:
   template<typename T>
   bool store_conditional(reg_t addr, T val)
   {
+    auto guard = sim->atomic_lock();
     bool have_reservation = check_load_reservation(addr, sizeof(T));
 
-    if (have_reservation)
+    if (have_reservation) {
       store(addr, val);
+      if (guard)
+        break_reservations(addr);
+    }
 
     yield_load_reservation();
 
     return have_reservation;
   }
 
-  static const reg_t ICACHE_ENTRIES = 4096;
-
-  inline size_t icache_index(reg_t addr)
+  // The way of addr's icache set that holds addr or, if none does, the one
+  // the next refill replaces.  Ways are replaced round-robin.
+  inline icache_entry_t* icache_way(reg_t addr)
   {
-    return (addr / PC_ALIGN) % ICACHE_ENTRIES;
+    icache_entry_t* set = &icache[((addr / PC_ALIGN) & icache_set_mask) * icache_ways];
+    for (reg_t way = 0; way < icache_ways; way++)
+      if (set[way].tag == addr)
+        return &set[way];
+    return &set[icache_victim % icache_ways];
   }
 
   template<typename T>
@@ -305,7 +382,7 @@ public:
 
     insn_fetch_t fetch = {proc->decode_insn(insn), insn};
     entry->tag = addr;
-    entry->next = &icache[icache_index(addr + length)];
+    entry->next = icache_way(addr + length);
     entry->data = fetch;
 
     auto [check_tracer, _, paddr] = access_tlb(tlb_insn, addr, TLB_FLAGS, TLB_CHECK_TRACER);
@@ -321,23 +398,45 @@ public:
 
   inline icache_entry_t* access_icache(reg_t addr)
   {
-    icache_entry_t* entry = &icache[icache_index(addr)];
+    icache_entry_t* entry = icache_way(addr);
     if (likely(entry->tag == addr)){
+      icache_stats.hits++;
       MMU_OBSERVE_FETCH(addr, entry->data.insn, insn_length(entry->data.insn.bits()));
       return entry;
     }
+    icache_stats.misses++;
+    icache_victim++;
     return refill_icache(addr, entry);
   }
 
+  static const reg_t BLOCK_ENTRIES = 4096;
+
+  inline size_t block_index(reg_t addr)
+  {
+    return (addr / PC_ALIGN) % BLOCK_ENTRIES;
+  }
+
+  inline block_entry_t* access_block(reg_t addr)
+  {
+    block_entry_t* b = &blocks[block_index(addr)];
+    if (likely(b->tag == addr))
+      return b;
+    return refill_block(addr, b);
+  }
+
+  // Building a block fetches ahead of execution, which fetch triggers would
+  // notice.
+  bool block_cache_usable() const { return !check_triggers_fetch; }
+
   inline insn_fetch_t load_insn(reg_t addr)
   {
-    return refill_icache(addr, &icache[icache_index(addr)])->data;
+    return refill_icache(addr, icache_way(addr))->data;
   }
 
-  std::tuple<bool, uintptr_t, reg_t> ALWAYS_INLINE access_tlb(const dtlb_entry_t* tlb, reg_t vaddr, reg_t allowed_flags = 0, reg_t required_flags = 0)
+  std::tuple<bool, uintptr_t, reg_t> ALWAYS_INLINE access_tlb(const std::vector<dtlb_entry_t>& tlb, reg_t vaddr, reg_t allowed_flags = 0, reg_t required_flags = 0)
   {
     auto vpn = vaddr / PGSIZE, pgoff = vaddr % PGSIZE;
-    auto& entry = tlb[vpn % TLB_ENTRIES];
+    auto& entry = tlb[tlb_way(tlb, vpn)];
     auto hit = likely((entry.tag & (~allowed_flags | required_flags)) == (vpn | required_flags));
     bool mmio = allowed_flags & TLB_MMIO & entry.tag;
     auto host_addr = mmio ? 0 : entry.data.host_addr + pgoff;
@@ -348,6 +447,9 @@ public:
   void flush_tlb();
   void flush_icache();
 
+  const sim_cache_stats_t& get_icache_stats() const { return icache_stats; }
+  const sim_cache_stats_t& get_tlb_stats(access_type type) const { return tlb_stats[type]; }
+
   void register_memtracer(memtracer_t*);
 
   int is_misaligned_enabled()
@@ -371,40 +473,74 @@ public:
   }
 
 private:
+  // An SC or AMO just stored to vaddr, whose translation is still in the TLB
+  // unless it is MMIO or traced.
+  void break_reservations(reg_t vaddr)
+  {
+    auto [tlb_hit, host_addr, paddr] = access_tlb(tlb_store, vaddr);
+    sim->break_reservations(this, tlb_hit ? paddr : (reg_t)-1);
+  }
+
   simif_t* sim;
   processor_t* proc;
   memtracer_list_t tracer;
   reg_t load_reservation_address;
   reg_t blocksz;
 
-  // implement an instruction cache for simulator performance
-  icache_entry_t icache[ICACHE_ENTRIES];
-
-  // implement a TLB for simulator performance
-  static const reg_t TLB_ENTRIES = 256;
+  // implement an instruction cache for simulator performance, with
+  // cfg_t::icache_entries entries in sets of cfg_t::icache_ways
+  std::vector<icache_entry_t> icache;
+  reg_t icache_set_mask;
+  reg_t icache_ways;
+  reg_t icache_victim;
+  sim_cache_stats_t icache_stats;
+
+  // ...and a basic-block cache over it, flushed along with it
+  block_entry_t blocks[BLOCK_ENTRIES];
+  block_entry_t* refill_block(reg_t addr, block_entry_t* b);
+
+  // implement a TLB for simulator performance, with cfg_t::tlb_entries
+  // entries in sets of cfg_t::tlb_ways
+  reg_t tlb_set_mask;
+  reg_t tlb_ways;
+  reg_t tlb_victim;
+  sim_cache_stats_t tlb_stats[3]; // indexed by access_type
   // If a TLB tag has TLB_CHECK_TRIGGERS set, then the MMU must check for a
   // trigger match before completing an access.
   static const reg_t TLB_CHECK_TRIGGERS = reg_t(1) << 63;
   static const reg_t TLB_CHECK_TRACER = reg_t(1) << 62;
   static const reg_t TLB_MMIO = reg_t(1) << 61;
   static const reg_t TLB_FLAGS = TLB_CHECK_TRIGGERS | TLB_CHECK_TRACER | TLB_MMIO;
-  dtlb_entry_t tlb_load[TLB_ENTRIES];
-  dtlb_entry_t tlb_store[TLB_ENTRIES];
-  dtlb_entry_t tlb_insn[TLB_ENTRIES];
+  std::vector<dtlb_entry_t> tlb_load;
+  std::vector<dtlb_entry_t> tlb_store;
+  std::vector<dtlb_entry_t> tlb_insn;
+
+  // The index of the way of vpn's set that holds vpn, with whatever flags,
+  // or else of the first way.
+  reg_t ALWAYS_INLINE tlb_way(const std::vector<dtlb_entry_t>& tlb, reg_t vpn) const
+  {
+    reg_t set = (vpn & tlb_set_mask) * tlb_ways;
+    for (reg_t way = 1; way < tlb_ways; way++)
+      if ((tlb[set + way].tag & ~TLB_FLAGS) == vpn)
+        return set + way;
+    return set;
+  }
 
   static const reg_t PTE_CACHE_ENTRIES = 251;
   pte_cache_entry_t pte_cache[PTE_CACHE_ENTRIES];
 
-  typedef bloom_filter_t<reg_t, simple_hash1, simple_hash2, TLB_ENTRIES * 16, 3> reverse_tags_t;
+  // sized for the default 256-entry TLBs
+  typedef bloom_filter_t<reg_t, simple_hash1, simple_hash2, 256 * 16, 3> reverse_tags_t;
   reverse_tags_t tlb_store_reverse_tags;
   reverse_tags_t tlb_insn_reverse_tags;
 
-  bool flush_tlb_ppn(reg_t ppn, dtlb_entry_t* tlb, reverse_tags_t& filter);
+  bool flush_tlb_ppn(reg_t ppn, std::vector<dtlb_entry_t>& tlb, reverse_tags_t& filter);
   void flush_itlb_ppn(reg_t ppn);
   void flush_stlb_ppn(reg_t ppn);
 
   // finish translation on a TLB miss and update the TLB
   tlb_entry_t refill_tlb(reg_t vaddr, reg_t paddr, char* host_addr, access_type type);
+  reg_t tlb_refill_way(const std::vector<dtlb_entry_t>& tlb, reg_t vpn);
   const char* fill_from_mmio(reg_t vaddr, reg_t paddr);
 
   // perform a stage2 translation for a given guest address
@@ -514,8 +650,10 @@ private:
   }
 
   inline insn_parcel_t fetch_insn_parcel(reg_t addr) {
-    if (auto [tlb_hit, host_addr, paddr] = access_tlb(tlb_insn, addr); tlb_hit)
+    if (auto [tlb_hit, host_addr, paddr] = access_tlb(tlb_insn, addr); tlb_hit) {
+      tlb_stats[FETCH].hits++;
       return from_le(*(insn_parcel_t*)host_addr);
+    }
 
     return from_le(fetch_slow_path(addr));
   }
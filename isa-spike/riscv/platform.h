@@ -8,6 +8,8 @@
 #define DEFAULT_PRIV       "MSU"
 #define CLINT_BASE         0x02000000
 #define CLINT_SIZE         0x000c0000
+#define CLIC_BASE          0x02800000
+#define CLIC_HART_SIZE     0x00010000
 #define PLIC_BASE          0x0c000000
 #define PLIC_SIZE          0x01000000
 #define PLIC_NDEV          31
@@ -5,6 +5,7 @@
 #include "simif.h"
 #include "sim.h"
 #include "dts.h"
+#include "arith.h"
 
 #define PLIC_MAX_CONTEXTS 15872
 
@@ -73,6 +74,9 @@
 
 #define REG_SIZE                0x1000000
 
+static_assert(PLIC_MAX_DEVICES / 32 <= 32, "ready_words holds one bit per word");
+static_assert(PLIC_MAX_PRIO < 32, "ready_prios holds one bit per priority");
+
 plic_t::plic_t(const simif_t* sim, uint32_t ndev)
   : num_ids(ndev + 1), num_ids_word(((ndev + 1) + (32 - 1)) / 32),
   max_prio((1UL << PLIC_PRIO_BITS) - 1), priority{}, level{}
@@ -89,40 +93,63 @@ plic_t::plic_t(const simif_t* sim, uint32_t ndev)
 
 uint32_t plic_t::context_best_pending(const plic_context_t *c)
 {
-  uint8_t best_id_prio = 0;
-  uint32_t best_id = 0;
-
-  for (uint32_t i = 0; i < num_ids_word; i++) {
-    if (!c->pending[i]) {
-      continue;
-    }
-
-    for (uint32_t j = 0; j < 32; j++) {
-      uint32_t id = i * 32 + j;
-      if ((num_ids <= id) ||
-          !(c->pending[i] & (1 << j)) ||
-          (c->claimed[i] & (1 << j))) {
-        continue;
-      }
-
-      if (!best_id ||
-          (best_id_prio < c->pending_priority[id])) {
-        best_id = id;
-        best_id_prio = c->pending_priority[id];
-      }
-    }
-  }
+  if (!c->ready_prios)
+    return 0;
 
   /*
   From Spec 1.0.0: 6. Priority Thresholds
   The PLIC will mask all PLIC interrupts of a priority less than or equal to
   threshold.
   */
-  if (best_id_prio <= c->priority_threshold) {
+  uint32_t prio = log2(c->ready_prios);
+  if (prio <= c->priority_threshold)
     return 0;
-  }
 
-  return best_id;
+  // Ties go to the lowest ID.
+  uint32_t word = ctz(c->ready_words[prio]);
+  return word * 32 + ctz(c->ready[prio][word]);
+}
+
+// Add or remove id in the bucket for its pending priority.
+void plic_t::context_set_ready(plic_context_t *c, uint32_t id, bool ready)
+{
+  uint32_t prio = c->pending_priority[id];
+  uint32_t id_word = id / 32;
+  uint32_t id_mask = 1 << (id % 32);
+  uint32_t* bucket = &c->ready[prio][id_word];
+
+  if (ready)
+    *bucket |= id_mask;
+  else
+    *bucket &= ~id_mask;
+
+  if (*bucket)
+    c->ready_words[prio] |= 1 << id_word;
+  else
+    c->ready_words[prio] &= ~(1 << id_word);
+
+  if (c->ready_words[prio])
+    c->ready_prios |= 1 << prio;
+  else
+    c->ready_prios &= ~(1 << prio);
+}
+
+// Make id pending at its current priority, or clear it, pending or claimed.
+void plic_t::context_set_pending(plic_context_t *c, uint32_t id, bool pending)
+{
+  uint32_t id_word = id / 32;
+  uint32_t id_mask = 1 << (id % 32);
+
+  context_set_ready(c, id, false);
+  if (pending) {
+    c->pending[id_word] |= id_mask;
+    c->pending_priority[id] = priority[id];
+    context_set_ready(c, id, !(c->claimed[id_word] & id_mask));
+  } else {
+    c->pending[id_word] &= ~id_mask;
+    c->pending_priority[id] = 0;
+    c->claimed[id_word] &= ~id_mask;
+  }
 }
 
 void plic_t::context_update(const plic_context_t *c)
@@ -141,6 +168,7 @@ uint32_t plic_t::context_claim(plic_context_t *c)
 
   if (best_id) {
     c->claimed[best_id_word] |= best_id_mask;
+    context_set_ready(c, best_id, false);
   }
 
   context_update(c);
@@ -177,7 +205,7 @@ bool plic_t::pending_read(reg_t offset, uint32_t *val)
 
   if (id_word < num_ids_word) {
     *val = 0;
-    for (auto context: contexts) {
+    for (const auto& context: contexts) {
         *val |= context.pending[id_word];
     }
   } else
@@ -213,21 +241,15 @@ bool plic_t::context_enable_write(plic_context_t *c,
 
   c->enable[id_word] = new_val;
 
-  for (uint32_t i = 0; i < 32; i++) {
+  for (uint32_t bits = xor_val; bits; bits &= bits - 1) {
+    uint32_t i = ctz(bits);
     uint32_t id = id_word * 32 + i;
     uint32_t id_mask = 1 << i;
-    uint8_t id_prio = priority[id];
-    if (!(xor_val & id_mask)) {
-      continue;
-    }
     if ((new_val & id_mask) &&
         (level[id_word] & id_mask)) {
-      c->pending[id_word] |= id_mask;
-      c->pending_priority[id] = id_prio;
+      context_set_pending(c, id, true);
     } else if (!(new_val & id_mask)) {
-      c->pending[id_word] &= ~id_mask;
-      c->pending_priority[id] = 0;
-      c->claimed[id_word] &= ~id_mask;
+      context_set_pending(c, id, false);
     }
   }
 
@@ -271,6 +293,8 @@ bool plic_t::context_write(plic_context_t *c,
       if ((val < num_ids) &&
           (c->enable[id_word] & id_mask)) {
         c->claimed[id_word] &= ~id_mask;
+        if (c->pending[id_word] & id_mask)
+          context_set_ready(c, val, true);
         update = true;
       }
       break;
@@ -293,7 +317,6 @@ void plic_t::set_interrupt_level(uint32_t id, int lvl)
     return;
   }
 
-  uint8_t id_prio = priority[id];
   uint32_t id_word = id / 32;
   uint32_t id_mask = 1 << (id % 32);
 
@@ -313,14 +336,7 @@ void plic_t::set_interrupt_level(uint32_t id, int lvl)
     plic_context_t* c = &contexts[i];
 
     if (c->enable[id_word] & id_mask) {
-      if (lvl) {
-        c->pending[id_word] |= id_mask;
-        c->pending_priority[id] = id_prio;
-      } else {
-        c->pending[id_word] &= ~id_mask;
-        c->pending_priority[id] = 0;
-        c->claimed[id_word] &= ~id_mask;
-      }
+      context_set_pending(c, id, lvl);
       context_update(c);
       break;
     }
@@ -10,6 +10,7 @@
 #include "platform.h"
 #include "vector_unit.h"
 #include "debug_defines.h"
+#include "devices.h"
 #include <cinttypes>
 #include <cmath>
 #include <cstdlib>
@@ -34,9 +35,9 @@ processor_t::processor_t(const char* isa_str, const char* priv_str,
                          FILE* log_file, std::ostream& sout_)
 : debug(false), halt_request(HR_NONE), isa(isa_str, priv_str), cfg(cfg),
   sim(sim), id(id), xlen(isa.get_max_xlen()),
-  histogram_enabled(false), log_commits_enabled(false),
+  histogram_enabled(false), log_commits_enabled(false), commit_ring(NULL),
   log_file(log_file), sout_(sout_.rdbuf()), halt_on_reset(halt_on_reset),
-  in_wfi(false), check_triggers_icount(false),
+  in_wfi(false), yield_requested(false), check_triggers_icount(false),
   impl_table(256, false), extension_enable_table(isa.get_extension_table()),
   last_pc(1), executions(1), TM(cfg->trigger_count)
 {
@@ -58,9 +59,27 @@ processor_t::processor_t(const char* isa_str, const char* priv_str,
   VU.VLEN = isa.get_vlen();
   VU.ELEN = isa.get_elen();
   VU.vlenb = isa.get_vlen() / 8;
+  VU.nbanks = cfg->vector_banks;
   VU.vstart_alu = 0;
 
   mmu = new mmu_t(sim, cfg->endianness, this, cfg->cache_blocksz);
+  cycle_model = cfg->cycle_model ? new cycle_model_t(cfg->cycle_model) : NULL;
+  window_ctrl = new window_ctrl_t(this, cfg);
+  emulated_instret = 0;
+  switch_profiler = NULL;
+  clic = NULL;
+  if (cfg->switch_profile) {
+    // With several harts, hart n writes <name>.<n><ext>.
+    std::string path = cfg->switch_profile;
+    if (cfg->nprocs() > 1) {
+      size_t dot = path.find_last_of('.');
+      size_t slash = path.find_last_of('/');
+      if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        dot = path.size();
+      path.insert(dot, "." + std::to_string(id));
+    }
+    switch_profiler = new switch_profiler_t(path);
+  }
 
   set_pmp_granularity(cfg->pmpgranularity);
   set_pmp_num(cfg->pmpregions);
@@ -91,15 +110,30 @@ processor_t::~processor_t()
       fprintf(stderr, "%0" PRIx64 " %" PRIu64 "\n", it.first, it.second);
   }
 
+  if (cfg->sim_cache_stats)
+  {
+    auto print_stats = [this](const char* name, const sim_cache_stats_t& stats) {
+      fprintf(stderr, "core%4" PRIu32 ": sim %-8s %12" PRIu64 " hits %12" PRIu64 " misses\n",
+              id, name, stats.hits, stats.misses);
+    };
+    print_stats("icache", mmu->get_icache_stats());
+    print_stats("itlb", mmu->get_tlb_stats(FETCH));
+    print_stats("load tlb", mmu->get_tlb_stats(LOAD));
+    print_stats("store tlb", mmu->get_tlb_stats(STORE));
+  }
+
   delete mmu;
+  delete window_ctrl;
+  delete switch_profiler;
+  delete cycle_model;
   delete disassembler;
 }
 
 void state_t::reset(processor_t* const proc, reg_t max_isa)
 {
   pc = DEFAULT_RSTVEC;
-  XPR.reset();
-  FPR.reset();
+  XPR.resize(proc->get_cfg().phys_regs, proc->get_cfg().window_granularity);
+  FPR.resize(proc->get_cfg().phys_fregs, proc->get_cfg().window_granularity);
 
   prv = prev_prv = PRV_M;
   v = prev_v = false;
@@ -162,43 +196,106 @@ public:
   window_config_csr_t(processor_t* p, reg_t addr) : csr_t(p, addr) {}
 
   reg_t read() const noexcept override {
-    auto& xpr = proc->get_state()->XPR;
-    return (xpr.get_window_size() << 16) | (xpr.get_base_offset() & 0xFFFF);
+    return proc->get_window_ctrl()->get_window();
   }
 
-  void write(const reg_t val) {
+protected:
+  bool unlogged_write(const reg_t val) noexcept override {
     reg_t new_base = val & 0xFFFF;
     reg_t new_size = (val >> 16) & 0xFFFF;
-    if (new_size == 0) new_size = 32; // Prevent 0-size lockouts
+    proc->get_window_ctrl()->set_window(new_base, new_size);
+    return true;
+  }
+};
 
-    proc->get_state()->XPR.set_window_config(new_base, new_size);
-    proc->get_state()->FPR.set_window_config(new_base, new_size);
+// The window the next xRET switches to (see window_ctrl_t).
+class staged_window_config_csr_t : public csr_t {
+public:
+  staged_window_config_csr_t(processor_t* p, reg_t addr) : csr_t(p, addr) {}
+
+  reg_t read() const noexcept override {
+    return proc->get_window_ctrl()->get_staged();
   }
 
-  bool unlogged_write(const reg_t val) noexcept override { write(val); return true; }
+protected:
+  bool unlogged_write(const reg_t val) noexcept override {
+    // FreeRTOS will write this when restoring a task context
+    proc->get_window_ctrl()->stage(val);
+    return true;
+  }
 };
 
-class prev_window_config_csr_t : public csr_t {
+// The FP window, independent of the integer one (see window_ctrl_t).
+class fp_window_config_csr_t : public csr_t {
 public:
-  prev_window_config_csr_t(processor_t* p, reg_t addr) : csr_t(p, addr) {}
+  fp_window_config_csr_t(processor_t* p, reg_t addr) : csr_t(p, addr) {}
 
   reg_t read() const noexcept override {
-    return proc->previous_window_config;
+    return proc->get_window_ctrl()->get_fp_window();
   }
 
-  void write(const reg_t val) {
-    // FreeRTOS will write this when restoring a task context
-    proc->previous_window_config = val;
+protected:
+  bool unlogged_write(const reg_t val) noexcept override {
+    proc->get_window_ctrl()->set_fp_window(val & 0xFFFF, (val >> 16) & 0xFFFF);
+    return true;
   }
-  
-  bool unlogged_write(const reg_t val) noexcept override { write(val); return true; }
 };
 
+// The FP window the next xRET switches to, or 0 to follow CSR 0x801.
+class staged_fp_window_config_csr_t : public csr_t {
+public:
+  staged_fp_window_config_csr_t(processor_t* p, reg_t addr) : csr_t(p, addr) {}
+
+  reg_t read() const noexcept override {
+    return proc->get_window_ctrl()->get_fp_staged();
+  }
+
+protected:
+  bool unlogged_write(const reg_t val) noexcept override {
+    proc->get_window_ctrl()->stage_fp(val);
+    return true;
+  }
+};
+
+void processor_t::dump_regfile(std::ostream& out) const
+{
+  reg_t window = window_ctrl->get_window();
+  reg_t staged = window_ctrl->get_staged();
+  size_t nphys = state.XPR.size();
+
+  out << std::endl << "[HARDWARE DUMP] Full Physical Register File State:" << std::endl
+      << "  Active window: base " << std::dec << (window & 0xFFFF)
+      << " size " << (window >> 16)
+      << "  Staged window: base " << (staged & 0xFFFF)
+      << " size " << ((staged >> 16) & 0xFFFF) << std::endl
+      << "================================================================" << std::endl;
+
+  // Iterate through the physical file in "Banks" of 32
+  for (size_t phys_start = 0; phys_start < nphys; phys_start += 32) {
+    size_t phys_end = std::min(phys_start + 32, nphys);
+
+    out << std::dec << std::setfill('0')
+        << "--- Physical Registers [" << std::setw(2) << phys_start
+        << " - " << std::setw(2) << phys_end - 1 << "] ---" << std::endl;
+
+    // Print in rows of 8 for readability
+    for (size_t row = phys_start; row < phys_end; row += 8) {
+      out << "  p" << std::dec << std::setw(2) << row << ": " << std::hex;
+      for (size_t p = row; p < std::min(row + 8, phys_end); p++)
+        out << std::setw(8) << zext_xlen(state.XPR.phys(p)) << " ";
+      out << std::endl;
+    }
+    out << std::endl;
+  }
+
+  out << std::dec << "================================================================" << std::endl << std::endl;
+}
+
 void processor_t::reset()
 {
   xlen = isa.get_max_xlen();
   state.reset(this, isa.get_max_isa());
-  previous_window_config = 0;
+  window_ctrl->reset();
   if (any_vector_extensions())
     VU.reset();
   in_wfi = false;
@@ -221,7 +318,9 @@ void processor_t::reset()
 
   // Register CSR 0x800 to control the Window
   state.csrmap[0x800] = std::make_shared<window_config_csr_t>(this, 0x800);
-  state.csrmap[0x801] = std::make_shared<prev_window_config_csr_t>(this, 0x801);
+  state.csrmap[0x801] = std::make_shared<staged_window_config_csr_t>(this, 0x801);
+  state.csrmap[0x802] = std::make_shared<fp_window_config_csr_t>(this, 0x802);
+  state.csrmap[0x803] = std::make_shared<staged_fp_window_config_csr_t>(this, 0x803);
 
   for (auto e : custom_extensions) { 
     for (auto &csr: e.second->get_csrs(*this))
@@ -327,8 +426,38 @@ reg_t processor_t::select_an_interrupt_with_default_priority(reg_t enabled_inter
   return enabled_interrupts;
 }
 
+void processor_t::yield()
+{
+  yield_requested = true;
+  // Make the fast path leave its icache chain after this instruction.
+  mmu->flush_icache();
+}
+
+bool processor_t::clic_interrupt_ready()
+{
+  return clic->interrupt_ready();
+}
+
+void processor_t::clic_return(reg_t mcause)
+{
+  if (clic)
+    clic->level = get_field(mcause, MCAUSE_MPIL);
+}
+
 void processor_t::take_interrupt(reg_t pending_interrupts)
 {
+  // CLIC interrupts outrank the standard ones and ignore mie; the level of
+  // the running handler and mintthresh mask them instead.
+  if (clic && clic->interrupt_ready() && !state.debug_mode) {
+    in_wfi = false;
+    const bool m_enabled = state.prv < PRV_M || get_field(state.mstatus->read(), MSTATUS_MIE);
+    const bool nmie = !(state.mnstatus && !get_field(state.mnstatus->read(), MNSTATUS_NMIE));
+    if (m_enabled && nmie) {
+      if (check_triggers_icount) TM.detect_icount_match();
+      throw trap_t(((reg_t)1 << (isa.get_max_xlen() - 1)) | clic->best_id);
+    }
+  }
+
   reg_t s_pending_interrupts = 0;
   reg_t vstopi = 0;
   reg_t vs_pending_interrupt = 0;
@@ -444,23 +573,6 @@ void processor_t::debug_output_log(std::stringstream *s)
 
 void processor_t::take_trap(trap_t& t, reg_t epc)
 {
-  // =========================================================
-  // AUTOMATIC WINDOW SWITCHING (HARDWARE TRAP ENTRY)
-  // =========================================================
-  
-  // 1. Capture the current window state (Base + Size)
-  reg_t current_base = state.XPR.get_base_offset();
-  reg_t current_size = state.XPR.get_window_size();
-  
-  // 2. Save it to 'previous_window_config' (CSR 0x801)
-  //    Format: [Size (16) | Base (16)]
-  previous_window_config = (current_size << 16) | (current_base & 0xFFFF);
-  
-  // 3. Force Register File to Kernel Mode (Base 0, Size 32)
-  //    This ensures x2 (SP) points to the physical Kernel Stack, not the Task Stack.
-  state.XPR.set_window_config(0, 32);
-  state.FPR.set_window_config(0, 32);
-
   unsigned max_xlen = isa.get_max_xlen();
 
   if (debug) {
@@ -484,17 +596,24 @@ void processor_t::take_trap(trap_t& t, reg_t epc)
     return;
   }
 
+  if (cycle_model)
+    cycle_model->trap_entry();
+
   // By default, trap to M-mode, unless delegated to HS-mode or VS-mode
   reg_t vsdeleg, hsdeleg;
   reg_t bit = t.cause();
   bool curr_virt = state.v;
   const reg_t interrupt_bit = (reg_t)1 << (max_xlen - 1);
   bool interrupt = (bit & interrupt_bit) != 0;
+  bool clic_interrupt = interrupt && clic && (bit & ~interrupt_bit) >= CLIC_FIRST_SOURCE &&
+                        (bit & ~interrupt_bit) < clic->sources.size();
   bool supv_double_trap = false;
   if (interrupt) {
     vsdeleg = (curr_virt && state.prv <= PRV_S) ? state.hideleg->read() : 0;
     hsdeleg = (state.prv <= PRV_S) ? (state.mideleg->read() | state.nonvirtual_sip->read()) : 0;
     bit &= ~((reg_t)1 << (max_xlen - 1));
+    if (clic_interrupt)
+      vsdeleg = hsdeleg = 0;
   } else {
     vsdeleg = (curr_virt && state.prv <= PRV_S) ? (state.medeleg->read() & state.hedeleg->read()) : 0;
     hsdeleg = (state.prv <= PRV_S) ? state.medeleg->read() : 0;
@@ -520,6 +639,7 @@ void processor_t::take_trap(trap_t& t, reg_t epc)
   }
   if ((state.prv <= PRV_S && bit < max_xlen && ((vsdeleg >> bit) & 1)) || vti) {
     // Handle the trap in VS-mode
+    window_ctrl->trap_enter(PRV_S, interrupt, bit);
     const reg_t adjusted_cause = interrupt && bit <= IRQ_VS_EXT && !vti ? bit - 1 : bit;  // VSSIP -> SSIP, etc;
     reg_t vector = (state.vstvec->read() & 1) && interrupt ? 4 * adjusted_cause : 0;
     state.pc = (state.vstvec->read() & ~(reg_t)1) + vector;
@@ -539,6 +659,7 @@ void processor_t::take_trap(trap_t& t, reg_t epc)
     set_privilege(PRV_S, true);
   } else if (state.prv <= PRV_S && bit < max_xlen && ((hsdeleg >> bit) & 1)) {
     // Handle the trap in HS-mode
+    window_ctrl->trap_enter(PRV_S, interrupt, bit);
     reg_t vector = (state.nonvirtual_stvec->read() & 1) && interrupt ? 4 * bit : 0;
     state.pc = (state.nonvirtual_stvec->read() & ~(reg_t)1) + vector;
     state.nonvirtual_scause->write(t.cause());
@@ -568,7 +689,7 @@ void processor_t::take_trap(trap_t& t, reg_t epc)
   } else {
     // Handle the trap in M-mode
     const reg_t vector = (state.mtvec->read() & 1) && interrupt ? 4 * bit : 0;
-    const reg_t trap_handler_address = (state.mtvec->read() & ~(reg_t)1) + vector;
+    reg_t trap_handler_address = (state.mtvec->read() & ~(reg_t)1) + vector;
     // RNMI sources, the feature isn't very useful, so pick an invalid address.
     // RNMI exception vector is implementation-defined.  Since we don't model
     const reg_t rnmi_trap_handler_address = 0;
@@ -586,9 +707,24 @@ void processor_t::take_trap(trap_t& t, reg_t epc)
       s = set_field(s, MSTATUS_MDT, 1);
     }
 
+    reg_t cause = supv_double_trap ? CAUSE_DOUBLE_TRAP : t.cause();
+    reg_t window = 0;
+    if (clic) {
+      // mcause.mpil keeps the interrupted level for mret.
+      cause = set_field(cause, MCAUSE_MPIL, clic->level);
+      if (clic_interrupt) {
+        const clic_source_t& src = clic->sources[bit];
+        if (src.attr & CLIC_ATTR_SHV)
+          trap_handler_address = src.vector;
+        window = src.window;
+        clic->claim(bit);
+      }
+    }
+
+    window_ctrl->trap_enter(PRV_M, interrupt, bit, window);
     state.pc = !nmie ? rnmi_trap_handler_address : trap_handler_address;
     state.mepc->write(epc);
-    state.mcause->write(supv_double_trap ? CAUSE_DOUBLE_TRAP : t.cause());
+    state.mcause->write(cause);
     state.mtval->write(t.get_tval());
     state.mtval2->write(supv_double_trap ? t.cause() : t.get_tval2());
     state.mtinst->write(t.get_tinst());
@@ -690,57 +826,7 @@ void processor_t::disasm(insn_t insn)
 void processor_t::put_csr(int which, reg_t val)
 {
   val = zext_xlen(val);
-  
-  // [0x801] Window Staging CSR (Write triggers "God Mode" Dump)
-  if (which == 0x801) {
-      state.window_staged = val;
-
-      // === GENERIC GOD MODE: DUMP ENTIRE PHYSICAL FILE (64 REGS) ===
-      fprintf(stderr, "\n[HARDWARE DUMP] Full Physical Register File State:\n");
-      fprintf(stderr, "================================================================\n");
-
-      // 1. Save current hardware state (so we can restore it after peeking)
-      reg_t saved_base = state.XPR.get_base_offset();
-      reg_t saved_size = state.XPR.get_window_size();
-
-      // 2. Iterate through the physical file in "Banks" of 32
-      //    (Assuming Total Physical Registers = 64)
-      for (int bank = 0; bank < 2; bank++) {
-          int phys_start = bank * 32;
-          
-          // Force the hardware window to look at this physical bank
-          // We set size=32 to view the whole bank as "x0-x31"
-          state.XPR.set_window_config(phys_start, 32);
-
-          fprintf(stderr, "--- Physical Registers [%02d - %02d] ---\n", phys_start, phys_start + 31);
-
-          // Print in rows of 8 for readability
-          for (int row = 0; row < 32; row += 8) {
-              fprintf(stderr, "  p%02d: ", phys_start + row);
-              for (int col = 0; col < 8; col++) {
-                  // We read logical register (row+col), which maps to (phys_start + row + col)
-                  reg_t val = state.XPR[row + col];
-                  fprintf(stderr, "%08lx ", (unsigned long)val);
-              }
-              fprintf(stderr, "\n");
-          }
-          fprintf(stderr, "\n");
-      }
-
-      // 3. RESTORE original state immediately
-      state.XPR.set_window_config(saved_base, saved_size);
-      
-      fprintf(stderr, "================================================================\n\n");
-      return;
-  }
 
-  // [0x800] Active Window (Read-Only in HW, but settable here for debug if needed)
-  if (which == 0x800) {
-      state.window_active = val;
-      return;
-  }
-
-  // Standard CSR handling
   auto search = state.csrmap.find(which);
   if (search != state.csrmap.end()) {
     search->second->write(val);
@@ -753,8 +839,6 @@ void processor_t::put_csr(int which, reg_t val)
 // side effects on reads.
 reg_t processor_t::get_csr(int which, insn_t insn, bool write, bool peek)
 {
-  if (which == 0x800) return state.window_active;
-  if (which == 0x801) return state.window_staged;
   auto search = state.csrmap.find(which);
   if (search != state.csrmap.end()) {
     if (!peek)
@@ -787,10 +871,15 @@ reg_t processor_t::throw_instruction_address_misaligned(reg_t pc)
 
 insn_func_t processor_t::decode_insn(insn_t insn)
 {
+  auto& entry = decode_cache[decode_cache_index(insn.bits())];
+  if (likely(entry.func && entry.bits == insn.bits()))
+    return entry.func;
+
   const auto& pool = opcode_map[insn.bits() % std::size(opcode_map)];
 
   for (auto p = pool.begin(); ; ++p) {
     if ((insn.bits() & p->mask) == p->match) {
+      entry = {insn.bits(), p->func};
       return p->func;
     }
   }
@@ -823,6 +912,8 @@ void processor_t::build_opcode_map()
 
   for (auto& p : opcode_map)
     p.clear();
+  for (auto& e : decode_cache)
+    e.func = NULL;
 
   for (auto& d : custom_instructions)
     build_one(d);
@@ -17,6 +17,14 @@
 #include "triggers.h"
 #include "../fesvr/memif.h"
 #include "vector_unit.h"
+#include "cycle_model.h"
+#include "window_ctrl.h"
+#include "switch_profiler.h"
+
+// Events that print the physical register file (see --dump-regfile-on).
+#define DUMP_REGFILE_ON_STAGE 1 // write to CSR 0x801
+#define DUMP_REGFILE_ON_TRAP  2 // trap entry, after the window switch
+#define DUMP_REGFILE_ON_XRET  4 // xRET, after the window switch
 
 #define FIRST_HPMCOUNTER 3
 #define N_HPMCOUNTERS 29
@@ -28,6 +36,8 @@ class simif_t;
 class trap_t;
 class extension_t;
 class disassembler_t;
+struct clic_context_t;
+class commit_ring_t;
 
 reg_t illegal_instruction(processor_t* p, insn_t insn, reg_t pc);
 
@@ -68,6 +78,13 @@ struct opcode_map_entry_t
   insn_func_t func;
 };
 
+// A decoded instruction; empty if func is NULL.
+struct decode_cache_entry_t
+{
+  insn_bits_t bits;
+  insn_func_t func;
+};
+
 // regnum, data
 typedef std::map<reg_t, freg_t> commit_log_reg_t;
 
@@ -89,8 +106,6 @@ struct state_t
   std::unordered_map<reg_t, csr_t_p> csrmap;
   reg_t prv;    // TODO: Can this be an enum instead?
   reg_t prev_prv;
-  reg_t window_active;  // Current Offset (for CSR 0x800)
-  reg_t window_staged;  // Next Offset (for CSR 0x801)
   bool prv_changed;
   bool v_changed;
   bool v;
@@ -104,6 +119,7 @@ struct state_t
   csr_t_p mcause;
   wide_counter_csr_t_p minstret;
   wide_counter_csr_t_p mcycle;
+  wide_counter_csr_t_p mhpmcounter[N_HPMCOUNTERS]; // only set for modeled events
   mie_csr_t_p mie;
   mip_csr_t_p mip;
   csr_t_p nonvirtual_sip;
@@ -232,7 +248,9 @@ public:
               FILE *log_file, std::ostream& sout_); // because of command line option --log and -s we need both
   ~processor_t();
 
-  reg_t previous_window_config;
+  // Print the whole physical XPR file (interactive "regfile" command and
+  // --dump-regfile-on).
+  void dump_regfile(std::ostream& out) const;
 
   const isa_parser_t &get_isa() const & { return isa; }
   const cfg_t &get_cfg() const & { return *cfg; }
@@ -241,13 +259,27 @@ public:
   void set_histogram(bool value);
   void enable_log_commits();
   bool get_log_commits_enabled() const { return log_commits_enabled; }
+  void set_commit_ring(commit_ring_t* ring) { commit_ring = ring; enable_log_commits(); }
+  commit_ring_t* get_commit_ring() { return commit_ring; }
   void reset();
-  void step(size_t n); // run for n cycles
+  // Run for n cycles; returns the number run, fewer than n after a yield().
+  size_t step(size_t n);
+  // End the current step() after the instruction in flight.
+  void yield();
   void put_csr(int which, reg_t val);
   uint32_t get_id() const { return id; }
   reg_t get_csr(int which, insn_t insn, bool write, bool peek = 0);
   reg_t get_csr(int which) { return get_csr(which, insn_t(0), false, true); }
   mmu_t* get_mmu() { return mmu; }
+  cycle_model_t* get_cycle_model() { return cycle_model; }
+  window_ctrl_t* get_window_ctrl() { return window_ctrl; }
+  switch_profiler_t* get_switch_profiler() { return switch_profiler; }
+  void set_clic(clic_context_t* c) { clic = c; }
+  // Restore the interrupt level that trap entry saved in mcause.
+  void clic_return(reg_t mcause);
+  // Count n instructions retired by emulated firmware toward minstret and
+  // mcycle at the end of the current chunk.
+  void retire_emulated(reg_t n) { emulated_instret += n; }
   state_t* get_state() { return &state; }
   unsigned get_xlen() const { return xlen; }
   unsigned paddr_bits() { return isa.get_max_xlen() == 64 ? 56 : 34; }
@@ -365,6 +397,11 @@ private:
 
   simif_t* sim;
   mmu_t* mmu; // main memory is always accessed via the mmu
+  cycle_model_t* cycle_model; // NULL unless --cycle-model is given
+  window_ctrl_t* window_ctrl;
+  switch_profiler_t* switch_profiler; // NULL unless --switch-profile is given
+  clic_context_t* clic; // NULL unless the platform has a CLIC
+  reg_t emulated_instret;
   std::unordered_map<std::string, extension_t*> custom_extensions;
   disassembler_t* disassembler;
   state_t state;
@@ -373,10 +410,12 @@ private:
   unsigned max_vaddr_bits;
   bool histogram_enabled;
   bool log_commits_enabled;
+  commit_ring_t *commit_ring; // commits go to a binary trace instead of log_file
   FILE *log_file;
   std::ostream sout_; // needed for socket command interface -s, also used for -d and -l, but not for --log
   bool halt_on_reset;
   bool in_wfi;
+  bool yield_requested;
   bool check_triggers_icount;
   std::vector<bool> impl_table;
 
@@ -386,12 +425,27 @@ private:
   mutable std::bitset<NUM_ISA_EXTENSIONS> extension_assumed_const;
 
   std::vector<opcode_map_entry_t> opcode_map[128];
+
+  // Direct-mapped cache of opcode_map lookups by instruction bits, so that
+  // icache refills of already-seen instructions skip the linear scan.
+  static const unsigned DECODE_CACHE_BITS = 13;
+  decode_cache_entry_t decode_cache[1 << DECODE_CACHE_BITS];
+  size_t decode_cache_index(insn_bits_t bits) const
+  {
+    return (bits * 0x9e3779b97f4a7c15ULL) >> (64 - DECODE_CACHE_BITS);
+  }
   std::vector<insn_desc_t> instructions;
   std::vector<insn_desc_t> custom_instructions;
   std::unordered_map<reg_t,uint64_t> pc_histogram;
 
-  void take_pending_interrupt() { take_interrupt(state.mip->read() & state.mie->read()); }
+  void take_pending_interrupt() {
+    reg_t pending = state.mip->read() & state.mie->read();
+    if (switch_profiler)
+      switch_profiler->interrupt_pending(pending != 0 || (clic && clic_interrupt_ready()));
+    take_interrupt(pending);
+  }
   void take_interrupt(reg_t mask); // take first enabled interrupt in mask
+  bool clic_interrupt_ready();
   void take_trap(trap_t& t, reg_t epc); // take an exception
   void take_trigger_action(triggers::action_t action, reg_t breakpoint_tval, reg_t epc, bool virt);
   void disasm(insn_t insn); // disassemble and print an instruction
@@ -34,6 +34,7 @@ const size_t sim_t::INTERLEAVE;
 
 extern device_factory_t* clint_factory;
 extern device_factory_t* plic_factory;
+extern device_factory_t* clic_factory;
 extern device_factory_t* ns16550_factory;
 
 sim_t::sim_t(const cfg_t *cfg, bool halted,
@@ -56,6 +57,14 @@ sim_t::sim_t(const cfg_t *cfg, bool halted,
     sout_(nullptr),
     current_step(0),
     current_proc(0),
+    round_len(INTERLEAVE),
+    rtc_insns(0),
+    quantum(cfg->quantum ? cfg->quantum : INTERLEAVE),
+    parallel(cfg->parallel_harts),
+    round_gen(0),
+    round_slice(0),
+    round_pending(0),
+    workers_exit(false),
     debug(false),
     histogram_enabled(false),
     log(false),
@@ -66,8 +75,11 @@ sim_t::sim_t(const cfg_t *cfg, bool halted,
 
   sout_.rdbuf(std::cerr.rdbuf()); // debug output goes to stderr by default
 
-  for (auto& x : mems)
+  for (auto& x : mems) {
     bus.add_device(x.first, x.second);
+    if (char* host = x.second->flat_contents())
+      flat_mems.push_back({x.first, x.second->size(), host});
+  }
 
   bus.add_device(DEBUG_START, &debug_module);
 
@@ -120,6 +132,7 @@ sim_t::sim_t(const cfg_t *cfg, bool halted,
   std::vector<device_factory_sargs_t> device_factories = {
     {clint_factory, {}},
     {plic_factory, {}},
+    {clic_factory, {}},
     {ns16550_factory, {}}};
   device_factories.insert(device_factories.end(),
                           plugin_device_factories.begin(),
@@ -265,6 +278,14 @@ sim_t::sim_t(const cfg_t *cfg, bool halted,
 
 sim_t::~sim_t()
 {
+  {
+    std::lock_guard<std::mutex> lock(round_mutex);
+    workers_exit = true;
+  }
+  round_start.notify_all();
+  for (auto& t : workers)
+    t.join();
+
   for (size_t i = 0; i < procs.size(); i++)
     delete procs[i];
   delete debug_mmu;
@@ -282,26 +303,135 @@ int sim_t::run()
   return htif_t::run();
 }
 
+// Each round, every hart runs round_len steps and then the devices are
+// ticked.  A round ends early at the next device event, e.g. an mtimecmp
+// crossing, so that its interrupt is taken at that exact instruction rather
+// than at the next quantum boundary.  A store that schedules an event
+// inside the current round ends the round right after the store.
+size_t sim_t::next_event_steps()
+{
+  size_t steps = quantum;
+  for (auto &dev : devices) {
+    reg_t event = dev->next_event();
+    if (event <= quantum / INSNS_PER_RTC_TICK)
+      steps = std::min(steps, size_t(event * INSNS_PER_RTC_TICK - rtc_insns));
+  }
+  return steps;
+}
+
+void sim_t::end_round()
+{
+  rtc_insns += round_len;
+  reg_t rtc_ticks = rtc_insns / INSNS_PER_RTC_TICK;
+  rtc_insns %= INSNS_PER_RTC_TICK;
+  for (auto &dev : devices) dev->tick(rtc_ticks);
+}
+
 void sim_t::step(size_t n)
 {
+  if (parallel && procs.size() > 1 && !debug)
+    return step_parallel(n);
+
   for (size_t i = 0, steps = 0; i < n; i += steps)
   {
-    steps = std::min(n - i, INTERLEAVE - current_step);
-    procs[current_proc]->step(steps);
+    if (current_step == 0 && current_proc == 0)
+      round_len = next_event_steps();
+
+    size_t slice = std::min(n - i, round_len - current_step);
+    steps = procs[current_proc]->step(slice);
+    if (steps < slice)
+      round_len = current_step + steps;
 
     current_step += steps;
-    if (current_step == INTERLEAVE)
+    if (current_step == round_len)
     {
       current_step = 0;
       procs[current_proc]->get_mmu()->yield_load_reservation();
       if (++current_proc == procs.size()) {
         current_proc = 0;
-        reg_t rtc_ticks = INTERLEAVE / INSNS_PER_RTC_TICK;
-        for (auto &dev : devices) dev->tick(rtc_ticks);
+        end_round();
       }
     }
   }
 }
+
+// The same rounds as the serial loop, but all harts run each slice at once,
+// the first on the caller's thread.  Devices are only ticked between slices,
+// so their schedule, and everything a hart sees of the others except the
+// order of their memory accesses, depends only on the quantum.  Stores do not
+// end a round early here, since the other harts are already running it.
+void sim_t::step_parallel(size_t n)
+{
+  if (workers.empty()) {
+    for (size_t i = 1; i < procs.size(); i++)
+      workers.emplace_back(&sim_t::run_worker, this, i);
+  }
+
+  for (size_t i = 0, steps = 0; i < n; i += steps)
+  {
+    if (current_step == 0)
+      round_len = next_event_steps();
+    steps = std::min(n - i, round_len - current_step);
+
+    {
+      std::lock_guard<std::mutex> lock(round_mutex);
+      round_slice = steps;
+      round_pending = workers.size();
+      round_gen++;
+    }
+    round_start.notify_all();
+    procs[0]->step(steps);
+    {
+      std::unique_lock<std::mutex> lock(round_mutex);
+      round_done.wait(lock, [this]{ return round_pending == 0; });
+    }
+
+    current_step += steps;
+    if (current_step == round_len)
+    {
+      current_step = 0;
+      for (processor_t *proc : procs)
+        proc->get_mmu()->yield_load_reservation();
+      end_round();
+    }
+  }
+}
+
+void sim_t::run_worker(size_t i)
+{
+  size_t gen = 0;
+  std::unique_lock<std::mutex> lock(round_mutex);
+  while (true) {
+    round_start.wait(lock, [&]{ return workers_exit || round_gen != gen; });
+    if (workers_exit)
+      return;
+    gen = round_gen;
+    size_t steps = round_slice;
+
+    lock.unlock();
+    procs[i]->step(steps);
+    lock.lock();
+
+    if (--round_pending == 0)
+      round_done.notify_one();
+  }
+}
+
+std::unique_lock<std::mutex> sim_t::atomic_lock()
+{
+  if (!workers.empty())
+    return std::unique_lock<std::mutex>(atomic_mutex);
+  return {};
+}
+
+void sim_t::break_reservations(mmu_t* mmu, reg_t paddr)
+{
+  for (processor_t *proc : procs) {
+    if (proc->get_mmu() != mmu)
+      proc->get_mmu()->break_load_reservation(paddr);
+  }
+}
+
 const char* sim_t::get_dts() {
   dts = dtb_to_dts(dtb);
   return dts.c_str(); 
@@ -328,6 +458,13 @@ void sim_t::configure_log(bool enable_log, bool enable_commitlog)
 {
   log = enable_log;
 
+  if (cfg->commit_trace) {
+    commit_trace.reset(new commit_trace_t(cfg->commit_trace, procs.size()));
+    for (size_t i = 0; i < procs.size(); i++)
+      procs[i]->set_commit_ring(commit_trace->ring(i));
+    return;
+  }
+
   if (!enable_commitlog)
     return;
 
@@ -346,6 +483,7 @@ bool sim_t::mmio_load(reg_t paddr, size_t len, uint8_t* bytes)
 {
   if (paddr + len < paddr)
     return false;
+  std::lock_guard<std::mutex> lock(bus_mutex);
   return bus.load(paddr, len, bytes);
 }
 
@@ -353,7 +491,14 @@ bool sim_t::mmio_store(reg_t paddr, size_t len, const uint8_t* bytes)
 {
   if (paddr + len < paddr)
     return false;
-  return bus.store(paddr, len, bytes);
+  std::lock_guard<std::mutex> lock(bus_mutex);
+  if (!bus.store(paddr, len, bytes))
+    return false;
+
+  // Stop the storing hart if it just scheduled an event inside this round.
+  if (workers.empty() && current_proc < procs.size() && next_event_steps() < round_len)
+    procs[current_proc]->yield();
+  return true;
 }
 
 void sim_t::set_rom()
@@ -402,8 +547,13 @@ void sim_t::set_rom()
 }
 
 char* sim_t::addr_to_mem(reg_t paddr) {
+  for (auto& m : flat_mems)
+    if (paddr - m.base < m.size)
+      return m.host + (paddr - m.base);
+
   auto page_offset = paddr % PGSIZE;
   auto page_addr = paddr - page_offset;
+  std::lock_guard<std::mutex> lock(mem_mutex);
 
   if (auto it = addr_to_mem_cache.find(page_addr); it != addr_to_mem_cache.end())
     return it->second + page_offset;
@@ -471,6 +621,14 @@ void sim_t::write_chunk(addr_t taddr, size_t len, const void* src)
   debug_mmu->store<uint64_t>(taddr, debug_mmu->from_target(data));
 }
 
+char* sim_t::host_mem(addr_t taddr, size_t len)
+{
+  for (auto& m : flat_mems)
+    if (taddr - m.base < m.size && len <= m.size - (taddr - m.base))
+      return m.host + (taddr - m.base);
+  return NULL;
+}
+
 endianness_t sim_t::get_target_endianness() const
 {
   return debug_mmu->is_target_big_endian()? endianness_big : endianness_little;
@@ -7,6 +7,7 @@
 #include "debug_module.h"
 #include "devices.h"
 #include "log_file.h"
+#include "commit_trace.h"
 #include "processor.h"
 #include "simif.h"
 
@@ -16,6 +17,9 @@
 #include <unordered_map>
 #include <string>
 #include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include <sys/types.h>
 
 class mmu_t;
@@ -75,6 +79,9 @@ private:
   std::vector<processor_t*> procs;
   std::map<size_t, processor_t*> harts;
   std::unordered_map<reg_t, char*> addr_to_mem_cache;
+  // mems mapped contiguously, which addr_to_mem needs neither cache nor lock for
+  struct flat_mem_t { reg_t base; reg_t size; char* host; };
+  std::vector<flat_mem_t> flat_mems;
   std::pair<reg_t, reg_t> initrd_range;
   std::string dts;
   std::string dtb;
@@ -84,6 +91,7 @@ private:
   std::shared_ptr<plic_t> plic;
   bus_t bus;
   log_file_t log_file;
+  std::unique_ptr<commit_trace_t> commit_trace;
 
   FILE *cmd_file; // pointer to debug command input file
 
@@ -96,6 +104,26 @@ private:
   void step(size_t n); // step through simulation
   size_t current_step;
   size_t current_proc;
+  size_t round_len; // steps each hart gets this round, at most quantum
+  size_t rtc_insns; // steps since the last whole RTC tick
+  const size_t quantum; // most steps a hart runs between device ticks
+  size_t next_event_steps();
+  void end_round();
+
+  // With --parallel, harts other than the first run on these threads, one
+  // round slice per round_gen, and meet the caller at the end of the slice.
+  const bool parallel;
+  std::vector<std::thread> workers;
+  std::mutex round_mutex;
+  std::condition_variable round_start, round_done;
+  size_t round_gen, round_slice, round_pending;
+  bool workers_exit;
+  void step_parallel(size_t n);
+  void run_worker(size_t i);
+
+  std::mutex mem_mutex; // guards addr_to_mem_cache and lazily allocated pages
+  std::mutex bus_mutex; // serializes MMIO
+  std::mutex atomic_mutex; // serializes LR, SC and AMOs across threads
   bool debug;
   bool histogram_enabled; // provide a histogram of PCs
   bool log;
@@ -111,6 +139,8 @@ private:
   // memory-mapped I/O routines
   virtual bool mmio_load(reg_t paddr, size_t len, uint8_t* bytes) override;
   virtual bool mmio_store(reg_t paddr, size_t len, const uint8_t* bytes) override;
+  virtual std::unique_lock<std::mutex> atomic_lock() override;
+  virtual void break_reservations(mmu_t* mmu, reg_t paddr) override;
   void set_rom();
 
   virtual const char* get_symbol(uint64_t paddr) override;
@@ -126,6 +156,7 @@ private:
   void interactive_run_silent(const std::string& cmd, const std::vector<std::string>& args);
   void interactive_vreg(const std::string& cmd, const std::vector<std::string>& args);
   void interactive_reg(const std::string& cmd, const std::vector<std::string>& args);
+  void interactive_regfile(const std::string& cmd, const std::vector<std::string>& args);
   void interactive_freg(const std::string& cmd, const std::vector<std::string>& args);
   void interactive_fregh(const std::string& cmd, const std::vector<std::string>& args);
   void interactive_fregs(const std::string& cmd, const std::vector<std::string>& args);
@@ -157,6 +188,7 @@ private:
   virtual void write_chunk(addr_t taddr, size_t len, const void* src) override;
   virtual size_t chunk_align() override { return 8; }
   virtual size_t chunk_max_size() override { return 8; }
+  virtual char* host_mem(addr_t taddr, size_t len) override;
   virtual endianness_t get_target_endianness() const override;
 
 public:
@@ -4,6 +4,7 @@
 #define _RISCV_SIMIF_H
 
 #include <map>
+#include <mutex>
 #include "decode.h"
 #include "cfg.h"
 
@@ -21,6 +22,12 @@ public:
   virtual bool mmio_fetch(reg_t paddr, size_t len, uint8_t* bytes) { return mmio_load(paddr, len, bytes); }
   virtual bool mmio_load(reg_t paddr, size_t len, uint8_t* bytes) = 0;
   virtual bool mmio_store(reg_t paddr, size_t len, const uint8_t* bytes) = 0;
+  // Held across LR, SC and AMOs when harts run on separate host threads;
+  // otherwise the returned lock owns nothing.
+  virtual std::unique_lock<std::mutex> atomic_lock() { return {}; }
+  // An SC or AMO by the given MMU stored to paddr (-1 if unknown), so the other harts
+  // lose their reservations on it.
+  virtual void break_reservations(mmu_t*, reg_t) {}
   // Callback for processors to let the simulation know they were reset.
   virtual void proc_reset(unsigned id) = 0;
 
@@ -0,0 +1,144 @@
+// See LICENSE for license details.
+
+#include "switch_profiler.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+
+static const char* kind_names[] = { "interrupt", "exception" };
+static const char* metric_names[] = { "instructions", "cycles" };
+
+switch_profiler_t::switch_profiler_t(const std::string& path)
+  : path(path), instret(0), cycles(0), asserted(false), assert_valid(false),
+    assert_instret(0), assert_cycles(0), start_pending(false), start_interrupt(false),
+    stop_pending(false), open(false), open_kind(KIND_EXCEPTION), start_instret(0),
+    start_cycles(0)
+{
+}
+
+switch_profiler_t::~switch_profiler_t()
+{
+  print_stats();
+
+  std::ofstream out(path);
+  if (!out) {
+    std::cerr << "Could not open switch profile " << path << std::endl;
+    return;
+  }
+  bool csv = path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+  if (csv)
+    write_csv(out);
+  else
+    write_json(out);
+}
+
+void switch_profiler_t::stamp()
+{
+  if (start_pending) {
+    start_pending = false;
+    open = true;
+    if (start_interrupt && assert_valid) {
+      // Charge the episode to the interrupt's assertion, once.
+      assert_valid = false;
+      open_kind = KIND_INTERRUPT;
+      start_instret = assert_instret;
+      start_cycles = assert_cycles;
+    } else {
+      open_kind = start_interrupt ? KIND_INTERRUPT : KIND_EXCEPTION;
+      start_instret = instret;
+      start_cycles = cycles;
+    }
+  }
+
+  if (stop_pending) {
+    stop_pending = false;
+    if (open) {
+      open = false;
+      samples[open_kind][METRIC_INSTRUCTIONS].push_back(instret - start_instret);
+      samples[open_kind][METRIC_CYCLES].push_back(cycles - start_cycles);
+    }
+  }
+}
+
+namespace {
+struct summary_t {
+  uint64_t min, p99, max;
+  double avg;
+};
+}
+
+static summary_t summarize(std::vector<uint64_t> v)
+{
+  summary_t s = {0, 0, 0, 0.0};
+  if (v.empty())
+    return s;
+  std::sort(v.begin(), v.end());
+  uint64_t sum = 0;
+  for (auto x : v)
+    sum += x;
+  s.min = v.front();
+  s.max = v.back();
+  // Nearest-rank percentile.
+  s.p99 = v[(v.size() * 99 + 99) / 100 - 1];
+  s.avg = double(sum) / v.size();
+  return s;
+}
+
+void switch_profiler_t::print_stats()
+{
+  for (int k = 0; k < N_KINDS; k++) {
+    std::cout << "Switch Profile " << std::left << std::setw(10) << kind_names[k]
+              << std::right << " Count: " << samples[k][0].size() << std::endl;
+    for (int m = 0; m < N_METRICS; m++) {
+      summary_t s = summarize(samples[k][m]);
+      std::cout << "  " << std::left << std::setw(13) << metric_names[m] << std::right
+                << " min " << s.min << " avg " << std::fixed << std::setprecision(2) << s.avg
+                << " p99 " << s.p99 << " max " << s.max
+                << " jitter " << s.max - s.min << std::endl;
+    }
+  }
+}
+
+void switch_profiler_t::write_json(std::ostream& out)
+{
+  out << "{" << std::endl;
+  for (int k = 0; k < N_KINDS; k++) {
+    out << "  \"" << kind_names[k] << "\": {" << std::endl
+        << "    \"count\": " << samples[k][0].size() << "," << std::endl;
+    for (int m = 0; m < N_METRICS; m++) {
+      summary_t s = summarize(samples[k][m]);
+      std::map<uint64_t, uint64_t> histogram;
+      for (auto x : samples[k][m])
+        histogram[x]++;
+
+      out << "    \"" << metric_names[m] << "\": {"
+          << "\"min\": " << s.min << ", \"avg\": " << std::fixed << std::setprecision(2) << s.avg
+          << ", \"p99\": " << s.p99 << ", \"max\": " << s.max
+          << ", \"jitter\": " << s.max - s.min << ", \"histogram\": {";
+      const char* sep = "";
+      for (auto& [latency, count] : histogram) {
+        out << sep << "\"" << latency << "\": " << count;
+        sep = ", ";
+      }
+      out << "}}" << (m + 1 < N_METRICS ? "," : "") << std::endl;
+    }
+    out << "  }" << (k + 1 < N_KINDS ? "," : "") << std::endl;
+  }
+  out << "}" << std::endl;
+}
+
+void switch_profiler_t::write_csv(std::ostream& out)
+{
+  out << "kind,metric,latency,count" << std::endl;
+  for (int k = 0; k < N_KINDS; k++) {
+    for (int m = 0; m < N_METRICS; m++) {
+      std::map<uint64_t, uint64_t> histogram;
+      for (auto x : samples[k][m])
+        histogram[x]++;
+      for (auto& [latency, count] : histogram)
+        out << kind_names[k] << "," << metric_names[m] << "," << latency << "," << count << std::endl;
+    }
+  }
+}
@@ -0,0 +1,82 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_SWITCH_PROFILER_H
+#define _RISCV_SWITCH_PROFILER_H
+
+#include "common.h"
+#include "decode.h"
+#include <string>
+#include <vector>
+
+// Context-switch latency profiler.
+//
+// Measures, for every outermost trap, the time from the trap's cause to the
+// first instruction after the xRET that leaves the last nested handler,
+// i.e. the first instruction of the next task.  For interrupts the clock
+// starts when the interrupt becomes pending and enabled in mie, so time
+// spent with interrupts masked counts as latency; for exceptions it starts
+// at the trapping instruction.  Latencies are kept in retired instructions
+// and in cycles (modeled cycles under --cycle-model, else one per
+// instruction).
+//
+// Trap entry and xRET both end a simulation chunk, so every event is
+// stamped exactly when processor_t::step() reports the chunk's retired
+// instructions through advance().
+class switch_profiler_t
+{
+ public:
+  explicit switch_profiler_t(const std::string& path);
+  ~switch_profiler_t();
+
+  // Called at the start of each chunk, before interrupts are taken.
+  void interrupt_pending(bool pending) {
+    if (pending && !asserted) {
+      assert_valid = true;
+      assert_instret = instret;
+      assert_cycles = cycles;
+    }
+    asserted = pending;
+  }
+
+  // Entry into, and return from, the outermost trap handler.
+  void trap_entry(bool interrupt) { start_pending = true; start_interrupt = interrupt; }
+  void trap_return() { stop_pending = true; }
+
+  void advance(reg_t n_instret, reg_t n_cycles) {
+    instret += n_instret;
+    cycles += n_cycles;
+    if (unlikely(start_pending || stop_pending))
+      stamp();
+  }
+
+ private:
+  enum kind_t { KIND_INTERRUPT, KIND_EXCEPTION, N_KINDS };
+  enum metric_t { METRIC_INSTRUCTIONS, METRIC_CYCLES, N_METRICS };
+
+  void stamp();
+  void print_stats();
+  void write_json(std::ostream& out);
+  void write_csv(std::ostream& out);
+
+  std::string path;
+
+  uint64_t instret;
+  uint64_t cycles;
+
+  bool asserted;     // an enabled interrupt was pending at the last check
+  bool assert_valid; // ...and no trap has been charged to it yet
+  uint64_t assert_instret;
+  uint64_t assert_cycles;
+
+  bool start_pending;
+  bool start_interrupt;
+  bool stop_pending;
+  bool open;
+  kind_t open_kind;
+  uint64_t start_instret;
+  uint64_t start_cycles;
+
+  std::vector<uint64_t> samples[N_KINDS][N_METRICS];
+};
+
+#endif
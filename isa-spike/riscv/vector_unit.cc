@@ -7,11 +7,11 @@
 
 void vectorUnit_t::vectorUnit_t::reset()
 {
-  free(reg_file);
+  free(bank_file);
   VLEN = get_vlen();
   ELEN = get_elen();
-  reg_file = malloc(NVPR * vlenb);
-  memset(reg_file, 0, NVPR * vlenb);
+  bank_file = calloc(nbanks, NVPR * vlenb);
+  select_bank(bank);
 
   auto state = p->get_state();
   state->add_csr(CSR_VXSAT, vxsat = std::make_shared<vxsat_csr_t>(p, CSR_VXSAT));
@@ -88,7 +88,10 @@ class vectorUnit_t
 {
 public:
   processor_t* p = nullptr;
-  void *reg_file = nullptr;
+  void *reg_file = nullptr; // the selected bank
+  void *bank_file = nullptr;
+  reg_t nbanks = 1;
+  reg_t bank = 0;
   int setvl_count = 0;
   reg_t vlmax = 0;
   reg_t vlenb = 0;
@@ -188,11 +191,19 @@ public:
 
   void reset();
 
+  // Point the architectural registers at physical bank b, of nbanks.  Each
+  // bank is a full set of NVPR registers, so switching needs no copying.
+  void select_bank(reg_t b) {
+    bank = b % nbanks;
+    if (bank_file)
+      reg_file = (char*)bank_file + bank * NVPR * vlenb;
+  }
+
   vectorUnit_t() {}
 
   ~vectorUnit_t() {
-    free(reg_file);
-    reg_file = 0;
+    free(bank_file);
+    bank_file = reg_file = 0;
   }
 
   reg_t set_vl(int rd, int rs1, reg_t reqVL, reg_t newType);
@@ -0,0 +1,345 @@
+// See LICENSE for license details.
+
+#include "window_ctrl.h"
+#include "processor.h"
+#include "mmu.h"
+#include <cinttypes>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+static void help()
+{
+  std::cerr << "Trap window configurations must be of the form" << std::endl;
+  std::cerr << "  target:base:size[,target:base:size...]" << std::endl;
+  std::cerr << "where target is m, s, or irq<n> for interrupt cause n < " << MAX_IRQ_WINDOWS << "," << std::endl;
+  std::cerr << "and base and size are below 65536 with size nonzero." << std::endl;
+  exit(1);
+}
+
+window_ctrl_t::window_ctrl_t(processor_t* proc, const cfg_t* cfg)
+  : proc(proc), cfg(cfg), partitioned(cfg->rf_partitioning), lazy_fpv(LAZY_FPV_OFF),
+    lazy_fp({"fp", SSTATUS_FS}), lazy_vec({"vector", SSTATUS_VS}),
+    save_area(cfg->window_save_area.value_or(0)), active(0), irq_window(), staged(0), fp_staged(0),
+    depth(0)
+{
+  spill = partitioned && cfg->window_save_area ? new window_spill_t(proc, save_area) : NULL;
+
+  for (auto& w : prv_window)
+    w = reg_t(32) << 16;
+
+  if (cfg->lazy_fpv && !strcmp(cfg->lazy_fpv, "track")) {
+    lazy_fpv = LAZY_FPV_TRACK;
+  } else if (cfg->lazy_fpv && !strcmp(cfg->lazy_fpv, "trap")) {
+    lazy_fpv = LAZY_FPV_TRAP;
+  } else if (cfg->lazy_fpv && strcmp(cfg->lazy_fpv, "off")) {
+    std::cerr << "--lazy-fpv must be off, track or trap" << std::endl;
+    exit(1);
+  }
+
+  std::string s(cfg->trap_windows ? cfg->trap_windows : "");
+  size_t pos = 0;
+  while (pos < s.size()) {
+    size_t end = s.find(',', pos);
+    if (end == std::string::npos)
+      end = s.size();
+    std::string item = s.substr(pos, end - pos);
+    pos = end + 1;
+
+    size_t colon1 = item.find(':');
+    size_t colon2 = colon1 == std::string::npos ? colon1 : item.find(':', colon1 + 1);
+    if (colon2 == std::string::npos || colon2 + 1 == item.size())
+      help();
+    std::string target = item.substr(0, colon1);
+    char* p;
+    reg_t base = strtoull(item.c_str() + colon1 + 1, &p, 0);
+    if (p != item.c_str() + colon2)
+      help();
+    reg_t size = strtoull(item.c_str() + colon2 + 1, &p, 0);
+    if (*p || base > 0xFFFF || size == 0 || size > 0xFFFF)
+      help();
+    reg_t window = (size << 16) | base;
+
+    if (target == "m") {
+      prv_window[PRV_M] = window;
+    } else if (target == "s") {
+      prv_window[PRV_S] = window;
+    } else if (target.compare(0, 3, "irq") == 0 && target.size() > 3) {
+      reg_t cause = strtoull(target.c_str() + 3, &p, 10);
+      if (*p || cause >= MAX_IRQ_WINDOWS)
+        help();
+      irq_window[cause] = window;
+    } else {
+      help();
+    }
+  }
+}
+
+window_ctrl_t::~window_ctrl_t()
+{
+  if (lazy_fpv != LAZY_FPV_OFF) {
+    for (auto* unit : {&lazy_fp, &lazy_vec})
+      fprintf(stderr, "core%4" PRIu32 ": lazy %-6s %12" PRIu64 " dirty switches %12" PRIu64
+              " saves avoided %12" PRIu64 " deferred to first use\n", proc->get_id(), unit->name,
+              unit->dirty_switches, unit->saves_avoided, unit->saves_deferred);
+  }
+  delete spill;
+}
+
+void window_ctrl_t::reset()
+{
+  staged = 0;
+  fp_staged = 0;
+  depth = 0;
+  for (auto* unit : {&lazy_fp, &lazy_vec}) {
+    unit->status.clear();
+    unit->owner.clear();
+  }
+  if (spill)
+    spill->reset();
+
+  if (!partitioned) {
+    // Frame 0 holds the trap handlers' registers, frame NXPR the task's.
+    proc->get_state()->XPR.resize(2 * NXPR);
+    active = reg_t(NXPR) << 16;
+    map(0, NXPR, 0);
+  }
+}
+
+void window_ctrl_t::set_window(reg_t base, reg_t size)
+{
+  if (!partitioned)
+    fw_save(active & 0xFFFF, active >> 16, frame());
+  switch_to(base, size, frame(), true);
+}
+
+reg_t window_ctrl_t::get_window() const
+{
+  if (!partitioned)
+    return active;
+  auto* state = proc->get_state();
+  reg_t base = spill ? spill->get_base() : state->XPR.get_base_offset();
+  return (state->XPR.get_window_size() << 16) | (base & 0xFFFF);
+}
+
+void window_ctrl_t::set_fp_window(reg_t base, reg_t size)
+{
+  if (partitioned)
+    map_fp(base, size);
+}
+
+reg_t window_ctrl_t::get_fp_window() const
+{
+  auto& fpr = proc->get_state()->FPR;
+  return (fpr.get_window_size() << 16) | (fpr.get_base_offset() & 0xFFFF);
+}
+
+reg_t window_ctrl_t::frame() const
+{
+  return proc->get_state()->XPR.get_base_offset();
+}
+
+void window_ctrl_t::map(reg_t base, reg_t size, reg_t phys_base, reg_t fp_window)
+{
+  auto* state = proc->get_state();
+  state->XPR.set_window_config(phys_base, size);
+  if (!partitioned)
+    state->FPR.set_window_config(0, size);
+  else if (fp_window)
+    map_fp(fp_window & 0xFFFF, fp_window >> 16);
+  else
+    map_fp(base, size);
+
+  reg_t old_bank = proc->VU.bank;
+  proc->VU.select_bank(partitioned ? base / size : 0);
+  if (lazy_fpv == LAZY_FPV_OFF && proc->VU.bank != old_bank &&
+      get_field(state->mstatus->read(), MSTATUS_VS) == 3)
+    state->mstatus->write(set_field(state->mstatus->read(), MSTATUS_VS, 2));
+}
+
+void window_ctrl_t::map_fp(reg_t base, reg_t size)
+{
+  auto* state = proc->get_state();
+  reg_t old = get_fp_window();
+  state->FPR.set_window_config(base, size ? size : NFPR);
+  if (lazy_fpv == LAZY_FPV_OFF && get_fp_window() != old &&
+      get_field(state->mstatus->read(), MSTATUS_FS) == 3)
+    state->mstatus->write(set_field(state->mstatus->read(), MSTATUS_FS, 2));
+}
+
+void window_ctrl_t::switch_to(reg_t base, reg_t size, reg_t frame, bool load, reg_t fp_window)
+{
+  if (size == 0)
+    size = NXPR; // Prevent 0-size lockouts, e.g. an xRET before any window is staged
+
+  if (!partitioned) {
+    size = std::min(size, reg_t(NXPR));
+    if (load)
+      fw_load(base, size, frame);
+    map(base, size, frame);
+    active = (size << 16) | (base & 0xFFFF);
+    return;
+  }
+
+  // With the spill/fill engine, base names a window in the virtual register
+  // space and the engine picks its physical frame.
+  reg_t old = get_window();
+  reg_t old_fp_bank = proc->get_state()->FPR.get_base_offset();
+  reg_t old_vec_bank = proc->VU.bank;
+  map(base, size, spill ? spill->activate(base, size) : base, fp_window);
+  if (lazy_fpv != LAZY_FPV_OFF && (old & 0xFFFF) != (base & 0xFFFF)) {
+    lazy_switch(lazy_fp, old & 0xFFFF, old_fp_bank, base & 0xFFFF,
+                proc->get_state()->FPR.get_base_offset());
+    lazy_switch(lazy_vec, old & 0xFFFF, old_vec_bank, base & 0xFFFF, proc->VU.bank);
+  }
+  if (proc->get_cycle_model() && get_window() != old)
+    proc->get_cycle_model()->window_switch();
+}
+
+void window_ctrl_t::lazy_switch(lazy_unit_t& unit, reg_t from, reg_t from_bank, reg_t to, reg_t to_bank)
+{
+  auto& mstatus = proc->get_state()->mstatus;
+  reg_t status = get_field(mstatus->read(), unit.mask);
+
+  // A window that had the unit on left its state in the bank.
+  unit.status[from] = status;
+  if (status != 0)
+    unit.owner[from_bank] = from;
+
+  auto owner = unit.owner.find(to_bank);
+  bool has_state = owner == unit.owner.end() || owner->second == to;
+  auto saved = unit.status.find(to);
+  // A window new to the unit starts Initial, if the unit is on at all.
+  reg_t next = saved != unit.status.end() ? saved->second : std::min(status, reg_t(1));
+
+  if (status == 3) {
+    unit.dirty_switches++;
+    if (to_bank != from_bank)
+      unit.saves_avoided++;
+    else if (lazy_fpv == LAZY_FPV_TRAP)
+      unit.saves_deferred++;
+  }
+  if (!has_state && lazy_fpv == LAZY_FPV_TRAP)
+    next = 0;
+
+  if (next != status)
+    mstatus->write(set_field(mstatus->read(), unit.mask, next));
+}
+
+void window_ctrl_t::fw_save(reg_t base, reg_t size, reg_t phys_base)
+{
+  auto& xpr = proc->get_state()->XPR;
+  mmu_t* mmu = proc->get_mmu();
+  unsigned bytes = proc->get_xlen() / 8;
+
+  // Logical x0 is hardwired to zero, so its slot is never saved.
+  for (reg_t r = 1; r < size; r++) {
+    reg_t addr = save_area + (base + r) * bytes;
+    reg_t val = xpr.phys(phys_base + r);
+    bool ok = bytes == 4 ? mmu->store_phys<uint32_t>(addr, val)
+                         : mmu->store_phys<uint64_t>(addr, val);
+    if (!ok) {
+      std::cerr << "Window save area address 0x" << std::hex << addr
+                << " is not backed by memory" << std::endl;
+      exit(1);
+    }
+  }
+
+  cycle_model_t* cm = proc->get_cycle_model();
+  fw_charge(size - 1, cm ? cm->store_latency() : 1);
+}
+
+void window_ctrl_t::fw_load(reg_t base, reg_t size, reg_t phys_base)
+{
+  auto& xpr = proc->get_state()->XPR;
+  mmu_t* mmu = proc->get_mmu();
+  unsigned bytes = proc->get_xlen() / 8;
+
+  for (reg_t r = 1; r < size; r++) {
+    reg_t addr = save_area + (base + r) * bytes;
+    uint64_t val;
+    bool ok;
+    if (bytes == 4) {
+      uint32_t val32;
+      ok = mmu->load_phys<uint32_t>(addr, &val32);
+      val = (sreg_t)(int32_t)val32;
+    } else {
+      ok = mmu->load_phys<uint64_t>(addr, &val);
+    }
+    if (!ok) {
+      std::cerr << "Window save area address 0x" << std::hex << addr
+                << " is not backed by memory" << std::endl;
+      exit(1);
+    }
+    xpr.write_phys(phys_base + r, val);
+  }
+
+  cycle_model_t* cm = proc->get_cycle_model();
+  fw_charge(size - 1, cm ? cm->load_latency() : 1);
+}
+
+// Each register moved by the emulated firmware is one retired load or store.
+void window_ctrl_t::fw_charge(reg_t n, reg_t latency)
+{
+  proc->retire_emulated(n);
+  if (proc->get_cycle_model() && latency > 1)
+    proc->get_cycle_model()->window_spill(n * (latency - 1));
+}
+
+void window_ctrl_t::stage(reg_t val)
+{
+  staged = val;
+  if (cfg->dump_regfile_on & DUMP_REGFILE_ON_STAGE)
+    proc->dump_regfile(std::cerr);
+}
+
+void window_ctrl_t::trap_enter(reg_t prv, bool interrupt, reg_t cause, reg_t window)
+{
+  if (!window)
+    window = interrupt && cause < MAX_IRQ_WINDOWS && irq_window[cause]
+             ? irq_window[cause] : prv_window[prv];
+
+  if (depth > 0) {
+    if (depth <= WINDOW_STACK_DEPTH) {
+      stack[depth - 1] = staged;
+      fp_stack[depth - 1] = fp_staged;
+    }
+    staged = get_window();
+    fp_staged = get_fp_window();
+  } else if (proc->get_switch_profiler()) {
+    proc->get_switch_profiler()->trap_entry(interrupt);
+  }
+  depth++;
+
+  // The handler's bank, so that sp is the handler's stack pointer rather
+  // than the interrupted task's.  Without partitioning, the firmware
+  // prologue saves the interrupted window and the handler runs in the
+  // persistent handler frame.
+  if (!partitioned)
+    fw_save(active & 0xFFFF, active >> 16, frame());
+  switch_to(window & 0xFFFF, window >> 16, 0, false);
+
+  if (cfg->dump_regfile_on & DUMP_REGFILE_ON_TRAP)
+    proc->dump_regfile(std::cerr);
+}
+
+void window_ctrl_t::trap_return()
+{
+  // Without partitioning, the firmware epilogue loads the staged window into
+  // the task frame, or into the handler frame when resuming an outer handler.
+  switch_to(staged & 0xFFFF, (staged >> 16) & 0xFFFF, depth > 1 ? 0 : NXPR, true, fp_staged);
+
+  if (depth > 0) {
+    if (--depth == 0) {
+      if (proc->get_switch_profiler())
+        proc->get_switch_profiler()->trap_return();
+    } else if (depth <= WINDOW_STACK_DEPTH) {
+      staged = stack[depth - 1];
+      fp_staged = fp_stack[depth - 1];
+    }
+  }
+
+  if (cfg->dump_regfile_on & DUMP_REGFILE_ON_XRET)
+    proc->dump_regfile(std::cerr);
+}
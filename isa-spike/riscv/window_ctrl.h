@@ -0,0 +1,150 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_WINDOW_CTRL_H
+#define _RISCV_WINDOW_CTRL_H
+
+#include "decode.h"
+#include "encoding.h"
+#include "window_spill.h"
+#include <unordered_map>
+
+class processor_t;
+class cfg_t;
+
+// Depth of the hardware stack of staged windows kept for nested traps.
+#define WINDOW_STACK_DEPTH 8
+// Interrupt causes that may be given their own trap window.
+#define MAX_IRQ_WINDOWS 64
+
+// How window switches treat the FP and vector units (--lazy-fpv).
+enum lazy_fpv_t {
+  LAZY_FPV_OFF,
+  LAZY_FPV_TRACK, // keep each window's mstatus.FS/VS
+  LAZY_FPV_TRAP,  // ...and turn a unit off for a window whose state it lacks
+};
+
+// Register-window controller.
+//
+// Owns all window state of a hart: the active window (CSR 0x800), the
+// staged window that the next xRET switches to (CSR 0x801), and a small
+// stack that preserves the staged window of each enclosing trap handler.
+// Windows are packed in CSR format, [Size (16) | Base (16)].
+//
+// Trap entry switches to the bank configured for the trap's target
+// (--trap-windows): the bank of the interrupt cause if it has one,
+// otherwise that of the target privilege, by default (base 0, size 32).
+// Giving ISRs and the scheduler disjoint banks lets a nested trap start
+// without clobbering the live registers of the handler it interrupts.
+//
+// A trap taken from outside any handler leaves the staged window alone, so
+// software may stage the next task before it traps.  A trap taken inside a
+// handler pushes the handler's staged window and stages the interrupted
+// one, so the inner xRET resumes the outer handler and pops its staged
+// window back.  Past WINDOW_STACK_DEPTH levels, outer staged windows are
+// lost and software must save CSR 0x801 itself.
+//
+// The FP registers have a physical file of their own (--phys-fregs), with
+// windows in the same format: the active one in CSR 0x802 and the one the
+// next xRET switches to in CSR 0x803, kept on the stack alongside CSR 0x801.
+// A staged FP window of 0 follows the integer window, taking the same base
+// and size in the FP file, and so does a trap handler's.  Moving the FP
+// window leaves the registers of the old one in place, so a Dirty mstatus.FS
+// becomes Clean: there is nothing left for software to save.
+//
+// With --vector-banks=<n>, the vector registers are banked too: a window
+// selects physical vector register file (base / size) modulo n, so a task
+// set of equal-size windows laid side by side gets consecutive banks and
+// keeps its vector state across switches without saving it.  The trap
+// handlers' default window (0, 32) uses bank 0.  As with the FP window,
+// moving to another bank turns a Dirty mstatus.VS Clean.
+//
+// With --lazy-fpv, a switch instead saves the outgoing window's FS and VS
+// and restores the incoming one's, so each window keeps its own dirty state.
+// The hart also remembers which window's state each FP and vector bank
+// holds.  In trap mode, a window switched onto a bank holding another
+// window's state gets FS or VS Off, so its first FP or vector instruction
+// traps and software swaps the state then, if at all.  Each switch that
+// leaves state Dirty counts as a save avoided if the incoming window uses
+// another bank, or as deferred to first use in trap mode; the counts are
+// printed at exit.
+//
+// With --rf-partitioning=off the hart instead has a single 32-register file
+// for tasks plus a persistent one for trap handlers, and every window switch
+// is performed by emulated firmware, as a software RTOS would: trap entry
+// stores the interrupted window to the save area, and xRET loads the staged
+// one.  Each register moved retires one emulated load or store, so the same
+// binary yields a software save/restore baseline in instructions, memory
+// traffic and modeled cycles.
+class window_ctrl_t
+{
+ public:
+  window_ctrl_t(processor_t* proc, const cfg_t* cfg);
+  ~window_ctrl_t();
+
+  void reset();
+
+  // Switch the XPR/FPR windows to (base, size), through the spill/fill
+  // engine or the emulated firmware if either is in use.  A size of 0
+  // selects 32 registers.
+  void set_window(reg_t base, reg_t size);
+  reg_t get_window() const;
+
+  reg_t get_staged() const { return staged; }
+  void stage(reg_t val);
+
+  // The FP window, in the same format.  Staging 0 makes the next xRET's FP
+  // window follow its integer window.
+  void set_fp_window(reg_t base, reg_t size);
+  reg_t get_fp_window() const;
+  reg_t get_fp_staged() const { return fp_staged; }
+  void stage_fp(reg_t val) { fp_staged = val; }
+
+  // A nonzero window, e.g. a CLIC source's, overrides the trap windows.
+  void trap_enter(reg_t prv, bool interrupt, reg_t cause, reg_t window = 0);
+  void trap_return();
+
+ private:
+  // With partitioning off, the window is mapped at physical base frame and,
+  // if load is set, loaded from the save area first.  The FP window goes to
+  // fp_window, or follows if that is 0.
+  void switch_to(reg_t base, reg_t size, reg_t frame, bool load, reg_t fp_window = 0);
+  void map(reg_t base, reg_t size, reg_t phys_base, reg_t fp_window = 0);
+  void map_fp(reg_t base, reg_t size);
+  reg_t frame() const;
+
+  // Emulated firmware save and restore of a window (partitioning off).
+  void fw_save(reg_t base, reg_t size, reg_t phys_base);
+  void fw_load(reg_t base, reg_t size, reg_t phys_base);
+  void fw_charge(reg_t n, reg_t latency);
+
+  // Ownership and dirty tracking of the FP or vector unit (--lazy-fpv).
+  struct lazy_unit_t {
+    const char* name;
+    reg_t mask; // SSTATUS_FS or SSTATUS_VS
+    std::unordered_map<reg_t, reg_t> status; // by window base, FS/VS when last switched out
+    std::unordered_map<reg_t, reg_t> owner;  // by bank, window base whose state it holds
+    uint64_t dirty_switches;
+    uint64_t saves_avoided;
+    uint64_t saves_deferred;
+  };
+  void lazy_switch(lazy_unit_t& unit, reg_t from, reg_t from_bank, reg_t to, reg_t to_bank);
+
+  processor_t* proc;
+  const cfg_t* cfg;
+  window_spill_t* spill; // NULL unless --window-spill is given
+  bool partitioned;
+  lazy_fpv_t lazy_fpv;
+  lazy_unit_t lazy_fp;
+  lazy_unit_t lazy_vec;
+  reg_t save_area;
+  reg_t active; // active window with partitioning off
+  reg_t prv_window[PRV_M + 1];    // indexed by target privilege
+  reg_t irq_window[MAX_IRQ_WINDOWS]; // indexed by interrupt cause; 0 if unset
+  reg_t staged;
+  reg_t fp_staged;
+  unsigned depth; // number of traps taken and not yet returned from
+  reg_t stack[WINDOW_STACK_DEPTH];
+  reg_t fp_stack[WINDOW_STACK_DEPTH];
+};
+
+#endif
@@ -0,0 +1,189 @@
+// See LICENSE for license details.
+
+#include "window_spill.h"
+#include "processor.h"
+#include "mmu.h"
+#include <iostream>
+#include <iomanip>
+
+window_spill_t::window_spill_t(processor_t* proc, reg_t save_area)
+  : proc(proc), save_area(save_area), active_base(0), clock(0), switches(0), spills(0),
+    fills(0), regs_spilled(0), regs_filled(0), cycles(0)
+{
+}
+
+window_spill_t::~window_spill_t()
+{
+  print_stats();
+}
+
+void window_spill_t::print_stats()
+{
+  std::cout << "Window Spill/Fill Switches:   " << switches << std::endl;
+  std::cout << "Window Spills:                " << spills << std::endl;
+  std::cout << "Window Fills:                 " << fills << std::endl;
+  std::cout << "Window Registers Spilled:     " << regs_spilled << std::endl;
+  std::cout << "Window Registers Filled:      " << regs_filled << std::endl;
+  std::cout << "Window Spill/Fill Cycles:     " << cycles << std::endl;
+  std::cout << "Window Spill/Fill Cycles/Switch: " << std::fixed << std::setprecision(2)
+            << (switches ? double(cycles) / switches : 0.0) << std::endl;
+}
+
+void window_spill_t::reset()
+{
+  windows.clear();
+  windows[0] = {proc->get_state()->XPR.size(), 0, clock, true, false};
+  active_base = 0;
+}
+
+reg_t window_spill_t::activate(reg_t base, reg_t size)
+{
+  auto& xpr = proc->get_state()->XPR;
+  // Frames are allocated in whole granules so that regfile_t keeps the
+  // physical base we hand it.
+  reg_t g = xpr.get_granularity();
+  base -= base % g;
+  size = std::min(std::max(size - size % g, g), reg_t(xpr.size()));
+  active_base = base;
+
+  auto it = windows.find(base);
+  if (it == windows.end())
+    it = windows.emplace(base, window_t{size, 0, 0, false, false}).first;
+  window_t& w = it->second;
+
+  if (w.last_use != clock || !w.resident)
+    switches++;
+  w.last_use = ++clock;
+
+  if (w.resident && w.size != size) {
+    // Shrink or grow in place if the frame allows it; otherwise the window
+    // moves, which costs a spill and refill.
+    if (size <= w.size || frame_free(w.phys_base, size, base))
+      w.size = size;
+    else
+      spill(base, w);
+  }
+
+  if (!w.resident) {
+    reg_t phys_base;
+    while (!find_frame(size, &phys_base, base)) {
+      auto victim = windows.end();
+      for (auto v = windows.begin(); v != windows.end(); ++v)
+        if (v->second.resident && v->first != base &&
+            (victim == windows.end() || v->second.last_use < victim->second.last_use))
+          victim = v;
+      assert(victim != windows.end());
+      spill(victim->first, victim->second);
+    }
+    w.size = size;
+    w.phys_base = phys_base;
+    w.resident = true;
+    fill(base, w);
+  }
+
+  return w.phys_base;
+}
+
+// Whether [phys_base, phys_base + size) lies within the physical file and
+// overlaps no resident window other than the one at ignore_base.
+bool window_spill_t::frame_free(reg_t phys_base, reg_t size, reg_t ignore_base)
+{
+  if (phys_base + size > proc->get_state()->XPR.size())
+    return false;
+  for (auto& [base, w] : windows)
+    if (w.resident && base != ignore_base &&
+        phys_base < w.phys_base + w.size && w.phys_base < phys_base + size)
+      return false;
+  return true;
+}
+
+// Find the lowest free physical frame of the given size.
+bool window_spill_t::find_frame(reg_t size, reg_t* phys_base, reg_t ignore_base)
+{
+  // A frame can only start at the bottom of the file or just past a
+  // resident window.
+  if (frame_free(0, size, ignore_base)) {
+    *phys_base = 0;
+    return true;
+  }
+  for (auto& [base, w] : windows) {
+    if (w.resident && base != ignore_base && frame_free(w.phys_base + w.size, size, ignore_base)) {
+      *phys_base = w.phys_base + w.size;
+      return true;
+    }
+  }
+  return false;
+}
+
+void window_spill_t::spill(reg_t base, window_t& w)
+{
+  auto& xpr = proc->get_state()->XPR;
+  mmu_t* mmu = proc->get_mmu();
+  unsigned bytes = proc->get_xlen() / 8;
+
+  // Logical x0 is hardwired to zero, so its slot is never saved.
+  for (reg_t r = 1; r < w.size; r++) {
+    reg_t addr = save_area + (base + r) * bytes;
+    reg_t val = xpr.phys(w.phys_base + r);
+    bool ok = bytes == 4 ? mmu->store_phys<uint32_t>(addr, val)
+                         : mmu->store_phys<uint64_t>(addr, val);
+    if (!ok) {
+      std::cerr << "Window save area address 0x" << std::hex << addr
+                << " is not backed by memory" << std::endl;
+      exit(1);
+    }
+  }
+
+  reg_t n = w.size ? w.size - 1 : 0;
+  reg_t c = n * (proc->get_cycle_model() ? proc->get_cycle_model()->store_latency() : 1);
+  if (proc->get_cycle_model())
+    proc->get_cycle_model()->window_spill(c);
+
+  spills++;
+  regs_spilled += n;
+  cycles += c;
+  w.resident = false;
+  w.saved = true;
+}
+
+void window_spill_t::fill(reg_t base, window_t& w)
+{
+  auto& xpr = proc->get_state()->XPR;
+  mmu_t* mmu = proc->get_mmu();
+  unsigned bytes = proc->get_xlen() / 8;
+
+  if (!w.saved) {
+    // A window that has never been spilled starts out zeroed.
+    for (reg_t r = 0; r < w.size; r++)
+      xpr.write_phys(w.phys_base + r, 0);
+    return;
+  }
+
+  for (reg_t r = 1; r < w.size; r++) {
+    reg_t addr = save_area + (base + r) * bytes;
+    uint64_t val;
+    bool ok;
+    if (bytes == 4) {
+      uint32_t val32;
+      ok = mmu->load_phys<uint32_t>(addr, &val32);
+      val = (sreg_t)(int32_t)val32;
+    } else {
+      ok = mmu->load_phys<uint64_t>(addr, &val);
+    }
+    if (!ok) {
+      std::cerr << "Window save area address 0x" << std::hex << addr
+                << " is not backed by memory" << std::endl;
+      exit(1);
+    }
+    xpr.write_phys(w.phys_base + r, val);
+  }
+
+  reg_t n = w.size ? w.size - 1 : 0;
+  reg_t c = n * (proc->get_cycle_model() ? proc->get_cycle_model()->load_latency() : 1);
+  if (proc->get_cycle_model())
+    proc->get_cycle_model()->window_spill(c);
+
+  fills++;
+  regs_filled += n;
+  cycles += c;
+}
@@ -0,0 +1,68 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_WINDOW_SPILL_H
+#define _RISCV_WINDOW_SPILL_H
+
+#include "decode.h"
+#include <map>
+
+class processor_t;
+
+// Hardware spill/fill engine for register windows.
+//
+// With the engine attached, window bases written through CSR 0x800/0x801
+// name windows in a virtual register space that may be larger than the
+// physical file.  Each window is given a physical frame when it is
+// activated; if no free frame is large enough, the least recently used
+// windows are evicted to a memory-backed save area until one is.  An
+// evicted window is refilled from the save area the next time it is
+// activated.  Virtual register r of the save area lives at
+// save_area + r * XLEN/8, and all spill/fill traffic is issued as physical
+// accesses through the hart's MMU so that cache models observe it.
+class window_spill_t
+{
+ public:
+  window_spill_t(processor_t* proc, reg_t save_area);
+  ~window_spill_t();
+
+  // Forget all windows; the whole physical file becomes window (0, size).
+  void reset();
+
+  // Make the virtual window (base, size) resident and return the physical
+  // base of its frame.
+  reg_t activate(reg_t base, reg_t size);
+
+  // Virtual base of the most recently activated window.
+  reg_t get_base() const { return active_base; }
+
+  void print_stats();
+
+ private:
+  struct window_t {
+    reg_t size;
+    reg_t phys_base;
+    uint64_t last_use;
+    bool resident;
+    bool saved;
+  };
+
+  bool frame_free(reg_t phys_base, reg_t size, reg_t ignore_base);
+  bool find_frame(reg_t size, reg_t* phys_base, reg_t ignore_base);
+  void spill(reg_t base, window_t& w);
+  void fill(reg_t base, window_t& w);
+
+  processor_t* proc;
+  reg_t save_area;
+  std::map<reg_t, window_t> windows; // keyed by virtual base
+  reg_t active_base;
+  uint64_t clock;
+
+  uint64_t switches;
+  uint64_t spills;
+  uint64_t fills;
+  uint64_t regs_spilled;
+  uint64_t regs_filled;
+  uint64_t cycles;
+};
+
+#endif
@@ -0,0 +1,137 @@
+// See LICENSE for license details.
+
+// This little program turns a binary commit trace written by
+//   spike --commit-trace=<file>
+// back into the text that --log-commits prints, e.g.
+//   core   0: 3 0x0000000080000000 (0x00000297) x5  0x0000000080000000
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "commit_trace.h"
+#include "decode.h"
+#include "disasm.h"
+
+static void print_value(FILE* out, int width, const void* data)
+{
+  switch (width) {
+    case 8:
+      fprintf(out, "0x%02" PRIx8, *(const uint8_t *)data);
+      break;
+    case 16:
+      fprintf(out, "0x%04" PRIx16, *(const uint16_t *)data);
+      break;
+    case 32:
+      fprintf(out, "0x%08" PRIx32, *(const uint32_t *)data);
+      break;
+    case 64:
+      fprintf(out, "0x%016" PRIx64, *(const uint64_t *)data);
+      break;
+    default: {
+      const uint8_t *arr = (const uint8_t *)data;
+      fprintf(out, "0x");
+      for (int idx = width / 8 - 1; idx >= 0; --idx)
+        fprintf(out, "%02" PRIx8, arr[idx]);
+      break;
+    }
+  }
+}
+
+static void print_value(FILE* out, int width, uint64_t val)
+{
+  print_value(out, width, &val);
+}
+
+int main(int argc, char** argv)
+{
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s <trace file>\n", argv[0]);
+    return 1;
+  }
+
+  FILE* in = fopen(argv[1], "rb");
+  if (!in) {
+    fprintf(stderr, "%s: %s\n", argv[1], strerror(errno));
+    return 1;
+  }
+
+  char magic[sizeof(COMMIT_TRACE_MAGIC)];
+  if (fread(magic, 1, sizeof(magic), in) != sizeof(magic) || memcmp(magic, COMMIT_TRACE_MAGIC, sizeof(magic))) {
+    fprintf(stderr, "%s: not a commit trace\n", argv[1]);
+    return 1;
+  }
+
+  FILE* out = stdout;
+  bool open_line = false;
+  int xlen = 64, flen = 64;
+  std::vector<uint8_t> vreg;
+  commit_record_t r;
+
+  while (fread(&r, sizeof(r), 1, in) == 1) {
+    switch (r.kind) {
+      case COMMIT_INSN:
+        if (open_line)
+          fprintf(out, "\n");
+        open_line = true;
+        xlen = r.b & 0xff;
+        flen = r.b >> 8;
+        fprintf(out, "core%4" PRId32 ": ", r.c);
+        fprintf(out, "%1d ", r.a);
+        print_value(out, xlen, r.x);
+        fprintf(out, " (");
+        print_value(out, insn_length(r.y) * 8, r.y);
+        fprintf(out, ")");
+        break;
+      case COMMIT_REG: {
+        uint64_t v[2] = { r.x, r.y };
+        if (r.a == 4)
+          fprintf(out, " c%d_%s ", r.b, csr_name(r.b));
+        else
+          fprintf(out, " %c%-2d ", r.a == 1 ? 'f' : 'x', r.b);
+        print_value(out, r.a == 1 ? flen : xlen, v);
+        break;
+      }
+      case COMMIT_VTYPE: {
+        int32_t lmul = (int32_t)r.c;
+        fprintf(out, " e%ld %s%ld l%ld",
+                (long)r.b, lmul < 0 ? "mf" : "m", (long)(lmul < 0 ? -lmul : lmul), (long)r.x);
+        break;
+      }
+      case COMMIT_VREG:
+        fprintf(out, " v%-2d ", r.b);
+        vreg.assign(r.c / 8, 0);
+        for (size_t i = 0; i < vreg.size(); i += 16) {
+          commit_record_t data;
+          if (fread(&data, sizeof(data), 1, in) != 1 || data.kind != COMMIT_DATA) {
+            fprintf(stderr, "%s: truncated vector register value\n", argv[1]);
+            return 1;
+          }
+          uint64_t chunk[2] = { data.x, data.y };
+          memcpy(&vreg[i], chunk, std::min(vreg.size() - i, size_t(16)));
+        }
+        print_value(out, r.c, vreg.data());
+        break;
+      case COMMIT_LOAD:
+        fprintf(out, " mem ");
+        print_value(out, xlen, r.x);
+        break;
+      case COMMIT_STORE:
+        fprintf(out, " mem ");
+        print_value(out, xlen, r.x);
+        fprintf(out, " ");
+        print_value(out, r.a << 3, r.y);
+        break;
+      default:
+        fprintf(stderr, "%s: bad record kind %d\n", argv[1], r.kind);
+        return 1;
+    }
+  }
+
+  if (open_line)
+    fprintf(out, "\n");
+  fclose(in);
+  return 0;
+}
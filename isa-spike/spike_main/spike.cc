@@ -13,6 +13,7 @@
 #include <stdexcept>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <vector>
 #include <string>
 #include <memory>
@@ -31,6 +32,9 @@ static void help(int exit_code = 1)
   fprintf(stderr, "  -m<n>                 Provide <n> MiB of target memory [default 2048]\n");
   fprintf(stderr, "  -m<a:m,b:n,...>       Provide memory regions of size m and n bytes\n");
   fprintf(stderr, "                          at base addresses a and b (with 4 KiB alignment)\n");
+  fprintf(stderr, "  --mem-backing=<b>     Hold memory regions sparsely, allocating each page as it is\n");
+  fprintf(stderr, "                          touched (sparse), or map each region whole, on normal (flat)\n");
+  fprintf(stderr, "                          or huge (huge) host pages [default sparse]\n");
   fprintf(stderr, "  -d                    Interactive debug mode\n");
   fprintf(stderr, "  -g                    Track histogram of PCs\n");
   fprintf(stderr, "  -l                    Generate a log of execution\n");
@@ -55,6 +59,8 @@ static void help(int exit_code = 1)
   fprintf(stderr, "                          specify --device=<name>,<args> to pass down extra args.\n");
   fprintf(stderr, "  --log-cache-miss      Generate a log of cache miss\n");
   fprintf(stderr, "  --log-commits         Generate a log of commits info\n");
+  fprintf(stderr, "  --commit-trace=<file> Write commits to <file> as a binary trace instead, which\n");
+  fprintf(stderr, "                          spike-commit-decode turns into --log-commits text\n");
   fprintf(stderr, "  --extension=<name>    Specify RoCC Extension\n");
   fprintf(stderr, "                          This flag can be used multiple times.\n");
   fprintf(stderr, "  --extlib=<name>       Shared library to load\n");
@@ -86,6 +92,44 @@ static void help(int exit_code = 1)
   fprintf(stderr, "  --dm-no-abstractauto  Debug module won't support the abstractauto register\n");
   fprintf(stderr, "  --blocksz=<size>      Cache block size (B) for CMO operations(powers of 2) [default 64]\n");
   fprintf(stderr, "  --instructions=<n>    Stop after n instructions\n");
+  fprintf(stderr, "  --cycle-model=<k:n,...> Charge modeled latencies to mcycle instead of CPI=1,\n");
+  fprintf(stderr, "                          with k one of alu, mul, div, fp, load, store, branch,\n");
+  fprintf(stderr, "                          csr, xret, trap, window, load-use (e.g. load:2,trap:5)\n");
+  fprintf(stderr, "  --phys-regs=<n>       Physical integer registers backing the register windows [default %zu]\n",
+          NXPR_PHYS_DEFAULT);
+  fprintf(stderr, "  --phys-fregs=<n>      Physical FP registers backing the FP register windows [default %zu]\n",
+          NFPR_PHYS_DEFAULT);
+  fprintf(stderr, "  --vector-banks=<n>    Physical vector register files, selected by the register\n");
+  fprintf(stderr, "                          window base; VLEN is set with --isa=..._zvl<N>b [default 1]\n");
+  fprintf(stderr, "  --window-granularity=<n> Round window bases and sizes down to multiples of n [default 1]\n");
+  fprintf(stderr, "  --window-spill=<addr> Treat window bases as virtual and spill least recently used\n");
+  fprintf(stderr, "                          windows to a save area at physical address <addr>\n");
+  fprintf(stderr, "  --dump-regfile-on=<e,...> Print the physical register file to stderr on each event e,\n");
+  fprintf(stderr, "                          one of stage (write to CSR 0x801), trap, or xret\n");
+  fprintf(stderr, "  --trap-windows=<t:base:size,...> Window entered on a trap to target t, one of m, s,\n");
+  fprintf(stderr, "                          or irq<n> for interrupt cause n [default m:0:32,s:0:32]\n");
+  fprintf(stderr, "  --lazy-fpv=<mode>     Keep mstatus.FS and VS per register window (track), and also\n");
+  fprintf(stderr, "                          turn the FP or vector unit off for a window whose state it\n");
+  fprintf(stderr, "                          does not hold, so that first use traps (trap); report\n");
+  fprintf(stderr, "                          the FP and vector saves avoided at exit [default off]\n");
+  fprintf(stderr, "  --switch-profile=<file> Write trap-to-next-task latency histograms to <file>,\n");
+  fprintf(stderr, "                          as CSV if it ends in .csv, else as JSON\n");
+  fprintf(stderr, "  --clic=<n>            Add a CLIC with <n> interrupt IDs: per-source level, priority,\n");
+  fprintf(stderr, "                          handler vector and register window\n");
+  fprintf(stderr, "  --rf-partitioning=off Run without register windows: window switches are done by\n");
+  fprintf(stderr, "                          emulated firmware that saves and restores registers through\n");
+  fprintf(stderr, "                          the --window-spill save area [default on]\n");
+  fprintf(stderr, "  --quantum=<n>         Run each hart for up to n instructions between device ticks\n");
+  fprintf(stderr, "                          and synchronization points [default 5000]\n");
+  fprintf(stderr, "  --parallel            Run each hart on its own host thread within a quantum.\n");
+  fprintf(stderr, "                          Without it, harts take turns on one thread with the same\n");
+  fprintf(stderr, "                          quantum, which makes a run deterministic and replayable\n");
+  fprintf(stderr, "  --sim-icache=<n>[:<w>] Give the simulator's own decoded-instruction cache n entries\n");
+  fprintf(stderr, "                          in sets of w ways, w one of 1, 2 or 4 [default 4096:1]\n");
+  fprintf(stderr, "  --sim-tlb=<n>[:<w>]   Give the simulator's own TLBs n entries in sets of w ways\n");
+  fprintf(stderr, "                          [default 256:1]\n");
+  fprintf(stderr, "  --sim-cache-stats     Print hits and misses in the simulator's icache and TLBs\n");
+  fprintf(stderr, "                          at exit\n");
 
   exit(exit_code);
 }
@@ -255,12 +299,13 @@ static std::vector<mem_cfg_t> parse_mem_layout(const char* arg)
   return merged_mem;
 }
 
-static std::vector<std::pair<reg_t, abstract_mem_t*>> make_mems(const std::vector<mem_cfg_t> &layout)
+static std::vector<std::pair<reg_t, abstract_mem_t*>> make_mems(const std::vector<mem_cfg_t> &layout,
+                                                                 mem_backing_t backing)
 {
   std::vector<std::pair<reg_t, abstract_mem_t*>> mems;
   mems.reserve(layout.size());
   for (const auto &cfg : layout) {
-    mems.push_back(std::make_pair(cfg.get_base(), new mem_t(cfg.get_size())));
+    mems.push_back(std::make_pair(cfg.get_base(), new mem_t(cfg.get_size(), backing)));
   }
   return mems;
 }
@@ -282,6 +327,43 @@ static unsigned long atoul_nonzero_safe(const char* s)
   return res;
 }
 
+static reg_t parse_dump_regfile_on(const char *s)
+{
+  std::string const str(s);
+  std::stringstream stream(str);
+  std::string event;
+  reg_t mask = 0;
+
+  while (std::getline(stream, event, ',')) {
+    if (event == "stage")
+      mask |= DUMP_REGFILE_ON_STAGE;
+    else if (event == "trap")
+      mask |= DUMP_REGFILE_ON_TRAP;
+    else if (event == "xret")
+      mask |= DUMP_REGFILE_ON_XRET;
+    else {
+      fprintf(stderr, "Unknown --dump-regfile-on event '%s'\n", event.c_str());
+      exit(-1);
+    }
+  }
+
+  return mask;
+}
+
+static void parse_sim_cache(const char* option, const char* s, reg_t& entries, reg_t& ways)
+{
+  char* p;
+  entries = strtoull(s, &p, 0);
+  ways = 1;
+  if (*p == ':')
+    ways = strtoull(p + 1, &p, 0);
+  if (*p || (ways != 1 && ways != 2 && ways != 4) ||
+      entries < ways || (entries & (entries - 1))) {
+    fprintf(stderr, "--%s must be a power of two of at least the number of ways, and ways 1, 2 or 4\n", option);
+    exit(-1);
+  }
+}
+
 static std::vector<size_t> parse_hartids(const char *s)
 {
   std::string const str(s);
@@ -378,6 +460,18 @@ int main(int argc, char** argv)
 #endif
   parser.option('p', 0, 1, [&](const char* s){nprocs = atoul_nonzero_safe(s);});
   parser.option('m', 0, 1, [&](const char* s){cfg.mem_layout = parse_mem_layout(s);});
+  parser.option(0, "mem-backing", 1, [&](const char* s){
+    if (!strcmp(s, "sparse")) {
+      cfg.mem_backing = mem_backing_sparse;
+    } else if (!strcmp(s, "flat")) {
+      cfg.mem_backing = mem_backing_flat;
+    } else if (!strcmp(s, "huge")) {
+      cfg.mem_backing = mem_backing_huge;
+    } else {
+      fprintf(stderr, "--mem-backing must be sparse, flat or huge\n");
+      exit(-1);
+    }
+  });
   parser.option(0, "halted", 0, [&](const char UNUSED *s){halted = true;});
   parser.option(0, "rbb-port", 1, [&](const char* s){use_rbb = true; rbb_port = atoul_safe(s);});
   parser.option(0, "pc", 1, [&](const char* s){cfg.start_pc = strtoull(s, 0, 0);});
@@ -460,6 +554,57 @@ int main(int argc, char** argv)
   parser.option(0, "instructions", 1, [&](const char* s){
     instructions = strtoull(s, 0, 0);
   });
+  parser.option(0, "cycle-model", 1, [&](const char* s){cfg.cycle_model = s;});
+  parser.option(0, "phys-regs", 1, [&](const char* s){
+    cfg.phys_regs = atoul_safe(s);
+    if (cfg.phys_regs < NXPR || cfg.phys_regs > NXPR_PHYS_MAX) {
+      fprintf(stderr, "--phys-regs must be between %d and %zu\n", NXPR, NXPR_PHYS_MAX);
+      exit(-1);
+    }
+  });
+  parser.option(0, "phys-fregs", 1, [&](const char* s){
+    cfg.phys_fregs = atoul_safe(s);
+    if (cfg.phys_fregs < NFPR || cfg.phys_fregs > NXPR_PHYS_MAX) {
+      fprintf(stderr, "--phys-fregs must be between %d and %zu\n", NFPR, NXPR_PHYS_MAX);
+      exit(-1);
+    }
+  });
+  parser.option(0, "vector-banks", 1, [&](const char* s){
+    cfg.vector_banks = atoul_nonzero_safe(s);
+    if (cfg.vector_banks > NXPR_PHYS_MAX / NXPR) {
+      fprintf(stderr, "--vector-banks must be between 1 and %zu\n", NXPR_PHYS_MAX / NXPR);
+      exit(-1);
+    }
+  });
+  parser.option(0, "window-granularity", 1, [&](const char* s){
+    cfg.window_granularity = atoul_nonzero_safe(s);
+    if (cfg.window_granularity > NXPR) {
+      fprintf(stderr, "--window-granularity must be between 1 and %d\n", NXPR);
+      exit(-1);
+    }
+  });
+  parser.option(0, "window-spill", 1, [&](const char* s){cfg.window_save_area = strtoull(s, 0, 0);});
+  parser.option(0, "dump-regfile-on", 1, [&](const char* s){cfg.dump_regfile_on = parse_dump_regfile_on(s);});
+  parser.option(0, "trap-windows", 1, [&](const char* s){cfg.trap_windows = s;});
+  parser.option(0, "lazy-fpv", 1, [&](const char* s){cfg.lazy_fpv = s;});
+  parser.option(0, "switch-profile", 1, [&](const char* s){cfg.switch_profile = s;});
+  parser.option(0, "clic", 1, [&](const char* s){cfg.clic_ndev = std::min(atoul_nonzero_safe(s), (unsigned long)CLIC_MAX_SOURCES - 1);});
+  parser.option(0, "rf-partitioning", 1, [&](const char* s){
+    if (!strcmp(s, "on")) {
+      cfg.rf_partitioning = true;
+    } else if (!strcmp(s, "off")) {
+      cfg.rf_partitioning = false;
+    } else {
+      fprintf(stderr, "--rf-partitioning must be on or off\n");
+      exit(-1);
+    }
+  });
+  parser.option(0, "quantum", 1, [&](const char* s){cfg.quantum = atoul_nonzero_safe(s);});
+  parser.option(0, "parallel", 0, [&](const char UNUSED *s){cfg.parallel_harts = true;});
+  parser.option(0, "commit-trace", 1, [&](const char* s){cfg.commit_trace = s;});
+  parser.option(0, "sim-icache", 1, [&](const char* s){parse_sim_cache("sim-icache", s, cfg.icache_entries, cfg.icache_ways);});
+  parser.option(0, "sim-tlb", 1, [&](const char* s){parse_sim_cache("sim-tlb", s, cfg.tlb_entries, cfg.tlb_ways);});
+  parser.option(0, "sim-cache-stats", 0, [&](const char UNUSED *s){cfg.sim_cache_stats = true;});
 
   auto argv1 = parser.parse(argv);
   std::vector<std::string> htif_args(argv1, (const char*const*)argv + argc);
@@ -467,8 +612,13 @@ int main(int argc, char** argv)
   if (!*argv1)
     help();
 
+  if (!cfg.rf_partitioning && !cfg.window_save_area) {
+    fprintf(stderr, "--rf-partitioning=off needs a save area (--window-spill=<addr>)\n");
+    exit(-1);
+  }
+
   std::vector<std::pair<reg_t, abstract_mem_t*>> mems =
-      make_mems(cfg.mem_layout);
+      make_mems(cfg.mem_layout, cfg.mem_backing);
 
   if (kernel && check_file_exists(kernel)) {
     const char *isa = cfg.isa;